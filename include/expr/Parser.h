@@ -218,6 +218,11 @@ namespace expr {
     /// ParseTopLevelDecl - Parse and return a top level declaration,
     /// which the caller assumes ownership of.
     ///
+    /// Query commands may be deleted as soon as they have been used,
+    /// so that large inputs can be processed one query at a time, but
+    /// array declarations are referred to by later queries and must
+    /// outlive the parser. Identifiers are owned by the parser.
+    ///
     /// \return NULL indicates the end of the file has been reached.
     virtual Decl *ParseTopLevelDecl() = 0;
 
@@ -35,7 +35,9 @@ enum QueryLoggingSolverType
     ALL_PC,       ///< Log all queries (un-optimised) in .pc (KQuery) format
     ALL_SMTLIB,   ///< Log all queries (un-optimised)  .smt2 (SMT-LIBv2) format
     SOLVER_PC,    ///< Log queries passed to solver (optimised) in .pc (KQuery) format
-    SOLVER_SMTLIB ///< Log queries passed to solver (optimised) in .smt2 (SMT-LIBv2) format
+    SOLVER_SMTLIB, ///< Log queries passed to solver (optimised) in .smt2 (SMT-LIBv2) format
+    ALL_BINARY,   ///< Log all queries (un-optimised) in the binary query log format
+    SOLVER_BINARY ///< Log queries passed to solver (optimised) in the binary query log format
 };
 
 /* Using cl::list<> instead of cl::bits<> results in quite a bit of ugliness when it comes to checking
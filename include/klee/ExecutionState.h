@@ -29,7 +29,6 @@ namespace klee {
   struct KFunction;
   struct KInstruction;
   class MemoryObject;
-  class PTreeNode;
   struct InstructionInfo;
 
 llvm::raw_ostream &operator<<(llvm::raw_ostream &os, const MemoryMap &mm);
@@ -79,6 +78,10 @@ public:
   stack_ty stack;
   ConstraintManager constraints;
   mutable double queryCost;
+  /// Exponentially decaying average of the solver time (in seconds)
+  /// spent on the recent queries of this path, used to predict the
+  /// cost of its next step.
+  mutable double recentQueryCost;
   double weight;
   AddressSpace addressSpace;
   TreeOStream pathOS, symPathOS;
@@ -89,7 +92,26 @@ public:
   bool forkDisabled;
 
   std::map<const std::string*, std::set<unsigned> > coveredLines;
-  PTreeNode *ptreeNode;
+  /// The leaf of this state in the process tree (a PTree::NodeId).
+  unsigned ptreeNode;
+
+  /// Positions of this state in the worklists of the active searchers,
+  /// indexed by searcher. Only meaningful to the searcher owning the
+  /// slot, see Searcher::getHandle().
+  std::vector<unsigned> searcherHandles;
+
+  /// The number of instructions executed along the path of this
+  /// state, used to find the state again when resuming a checkpoint.
+  uint64_t steppedInstructions;
+
+  /// The instruction count at which this state was last selected to
+  /// run, used to find cold states when offloading.
+  uint64_t lastScheduled;
+
+  /// Set while the memory contents of this state are held on disk by
+  /// the StateOffloader. A suspended state must be resumed before it
+  /// is run, merged, copied or terminated.
+  bool suspended;
 
   /// ordered list of symbolics: used to generate test cases. 
   //
@@ -110,7 +132,9 @@ public:
   void removeFnAlias(std::string fn);
   
 private:
-  ExecutionState() : fakeState(false), ptreeNode(0) {}
+  ExecutionState()
+    : fakeState(false), ptreeNode(0), steppedInstructions(0),
+      lastScheduled(0), suspended(false) {}
 
 public:
   ExecutionState(KFunction *kf);
@@ -133,7 +157,17 @@ public:
     constraints.addConstraint(e); 
   }
 
-  bool merge(const ExecutionState &b);
+  /// Account \a seconds of solver time to this path.
+  void addQueryCost(double seconds) const {
+    queryCost += seconds;
+    recentQueryCost = .75 * recentQueryCost + .25 * seconds;
+  }
+
+  /// Merge the state b, which is at the same instruction, into this one.
+  /// If maxSelects is non-zero, do not merge if it would take more than
+  /// that many select expressions to combine the registers and memory of
+  /// the two states.
+  bool merge(const ExecutionState &b, unsigned maxSelects = 0);
   void dumpStack(llvm::raw_ostream &out) const;
 };
 
@@ -637,6 +637,15 @@ private:
 	 */
 	static std::map<unsigned, const Array *> symbolicArraySingletonMap;
 
+	/*
+	 * The constant arrays created by CreateUniqueConstantArray, keyed by
+	 * contentHash().
+	 */
+	static std::multimap<unsigned, const Array *> constantArrayPool;
+
+	unsigned contentHash() const;
+	bool hasSameContents(const Array &b) const;
+
 	//This shouldn't be allowed since it's a singleton class
 	Array(const Array& array);
 
@@ -687,6 +696,19 @@ public:
 			const ref<ConstantExpr> *constantValuesBegin = 0,
 			const ref<ConstantExpr> *constantValuesEnd = 0,
 			Expr::Width _domain = Expr::Int32, Expr::Width _range = Expr::Int8);
+
+	/*
+	 * Create a constant array, or return an earlier one (created through
+	 * this function, under any name) with the same contents.  Meant for
+	 * arrays whose name carries no meaning, such as the snapshots of
+	 * concrete objects, so that identical contents share one Array and
+	 * the solver caches keyed on it.
+	 */
+	static const Array * CreateUniqueConstantArray(const std::string &_name,
+			uint64_t _size,
+			const ref<ConstantExpr> *constantValuesBegin,
+			const ref<ConstantExpr> *constantValuesEnd,
+			Expr::Width _domain = Expr::Int32, Expr::Width _range = Expr::Int8);
 };
 
 /// Class representing a complete list of updates into an array.
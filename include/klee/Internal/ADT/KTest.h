@@ -22,6 +22,8 @@ extern "C" {
     unsigned char *bytes;
   };
   
+  typedef struct KTestMapping KTestMapping;
+
   typedef struct KTest KTest;
   struct KTest {
     /* file format version */
@@ -35,6 +37,12 @@ extern "C" {
 
     unsigned numObjects;
     KTestObject *objects;
+
+    /* non-NULL for tests read by the functions below, which allocate
+       the test, its arrays and strings in one block, and point the
+       object bytes into the file contents they keep (see kTest_free);
+       NULL for tests whose fields were allocated one by one */
+    KTestMapping *mapping;
   };
 
   
@@ -47,6 +55,11 @@ extern "C" {
   /* returns NULL on (unspecified) error */
   KTest* kTest_fromFile(const char *path);
 
+  /* like kTest_fromFile, but maps the file instead of reading it: the
+     object bytes are views into a private (copy on write) mapping, so
+     the file must not be truncated while the test is in use */
+  KTest* kTest_mapFile(const char *path);
+
   /* returns 1 on success, 0 on (unspecified) error */
   int   kTest_toFile(KTest *, const char *path);
   
@@ -55,6 +68,39 @@ extern "C" {
 
   void  kTest_free(KTest *);
 
+  /* A pack is a single file holding many tests, for large test suites:
+     a header, the tests in .ktest format one after the other, and an
+     index of their offsets written when the pack is finished. */
+  typedef struct KTestPack KTestPack;
+  typedef struct KTestPackWriter KTestPackWriter;
+
+  /* return true iff file at path matches the pack header */
+  int   kTest_isKTestPack(const char *path);
+
+  /* maps the pack; returns NULL on (unspecified) error */
+  KTestPack* kTestPack_open(const char *path);
+
+  unsigned kTestPack_numTests(KTestPack *);
+
+  /* returns the index'th test of the pack as a view into its mapping
+     (see kTest_mapFile), to be released with kTest_free; it may
+     outlive the pack. returns NULL on (unspecified) error */
+  KTest* kTestPack_getTest(KTestPack *, unsigned index);
+
+  void  kTestPack_close(KTestPack *);
+
+  /* returns NULL on (unspecified) error */
+  KTestPackWriter* kTestPack_create(const char *path);
+
+  /* writes the test through to the file, so that an unfinished pack
+     still opens with every test added; returns 1 on success, 0 on
+     (unspecified) error */
+  int   kTestPack_add(KTestPackWriter *, KTest *);
+
+  /* writes the index and closes the pack; returns 1 on success, 0 on
+     (unspecified) error */
+  int   kTestPack_finish(KTestPackWriter *);
+
 #ifdef __cplusplus
 }
 #endif
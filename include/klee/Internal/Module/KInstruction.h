@@ -15,6 +15,7 @@
 #include <vector>
 
 namespace llvm {
+  class Function;
   class Instruction;
 }
 
@@ -27,6 +28,10 @@ namespace klee {
   /// KInstruction - Intermediate instruction representation used
   /// during execution.
   struct KInstruction {
+    /// ConcreteOp - An integer binary operation or comparison specialized
+    /// for one operand width, over the values of two constant operands.
+    typedef uint64_t (*ConcreteOp)(uint64_t left, uint64_t right);
+
     llvm::Instruction *inst;    
     const InstructionInfo *info;
 
@@ -37,9 +42,36 @@ namespace klee {
     int *operands;
     /// Destination register index.
     unsigned dest;
+    /// Width in bits of the value produced (as an Expr::Width), or 0 if
+    /// the instruction does not produce a sized value.
+    unsigned width;
+    /// Evaluation of this instruction when both operands are constants,
+    /// decoded once so that concrete execution skips building and
+    /// folding expressions. Null if the instruction has none.
+    ConcreteOp concreteOp;
 
   public:
     virtual ~KInstruction(); 
+
+    /// getConcreteOp - Return the specialized evaluation of \arg i over
+    /// constant operands of \arg width bits, or null if \arg i is not an
+    /// integer add, sub, mul, and, or, xor or comparison of a common
+    /// width (1, 8, 16, 32 or 64 bits).
+    static ConcreteOp getConcreteOp(const llvm::Instruction *i,
+                                    unsigned width);
+  };
+
+  struct KCallInstruction : KInstruction {
+    /// callee - The function called directly by this instruction, if its
+    /// special function handler has been resolved, otherwise null.
+    llvm::Function *callee;
+
+    /// specialHandler - The index plus one of the special function handler
+    /// for callee, or zero if it has none. Only valid for calls to callee
+    /// (function aliasing may redirect a direct call elsewhere).
+    unsigned specialHandler;
+
+    KCallInstruction() : callee(0), specialHandler(0) {}
   };
 
   struct KGEPInstruction : KInstruction {
@@ -121,6 +121,12 @@ namespace klee {
     KModule(llvm::Module *_module);
     ~KModule();
 
+    /// Link in the intrinsic library and run the instrumentation and
+    /// optimization passes. The result depends only on the module and
+    /// the options, so it can be saved and reused (see
+    /// ModuleOptions::Prepared).
+    void transform(const Interpreter::ModuleOptions &opts);
+
     /// Initialize local data structures.
     //
     // FIXME: ihandler should not be here
@@ -11,10 +11,15 @@
 #define KLEE_OPT_LOGGINGSOLVER_H
 
 #include "klee/Expr.h"
+#include "klee/util/ExprHashMap.h"
 
+#include <map>
+#include <string>
 #include <vector>
+#include <stdint.h>
 
 namespace klee {
+  class ExprBuilder;
   struct Query;
 
   class QueryLogEntry {
@@ -57,7 +62,78 @@ namespace klee {
       }
     }
   };
-  
+
+  /// Writes queries to a compact binary log.
+  ///
+  /// Expressions, update lists and arrays are written once and then
+  /// referred to by id, across queries as well as within one, so a log
+  /// grows with the new parts of each query rather than with its size.
+  /// Encoding is done by the caller; the encoded records are written
+  /// out by a background thread.
+  class QueryLogWriter {
+    struct OutputQueue;
+
+    std::string buffer;
+    OutputQueue *queue;
+
+    ExprHashMap<unsigned> exprIds;
+    std::map<const UpdateNode*, unsigned> updateIds;
+    std::vector<UpdateList> updates; // keeps the nodes in updateIds alive
+    std::map<const Array*, unsigned> arrayIds;
+
+    void writeUnsigned(uint64_t value);
+    void writeString(const std::string &s);
+    void writeAPInt(const llvm::APInt &value);
+    unsigned writeArray(const Array *array);
+    unsigned writeUpdates(const UpdateList &ul);
+    unsigned writeExpr(const ref<Expr> &e);
+    void flushBuffer(bool force);
+
+  public:
+    /// Open the log at the given path, setting error on failure.
+    QueryLogWriter(const std::string &path, std::string &error);
+    ~QueryLogWriter();
+
+    void write(const QueryLogEntry &entry, const QueryLogResult &result);
+  };
+
+  /// Reads back the queries written by a QueryLogWriter.
+  class QueryLogReader {
+    const unsigned char *pos, *end;
+    ExprBuilder *builder;
+    std::string error;
+
+    std::vector< ref<Expr> > exprs;
+    std::vector<UpdateList> updates;
+    std::vector<const Array*> arrays;
+
+    bool readUnsigned(uint64_t &value);
+    bool readUnsigned(unsigned &value);
+    bool readString(std::string &s);
+    bool readAPInt(unsigned width, llvm::APInt &value);
+    bool readExprId(ref<Expr> &e);
+    bool readArrayId(const Array *&array);
+    bool readArray();
+    bool readUpdate();
+    bool readExpr();
+    bool fail(const char *message);
+
+  public:
+    /// Read the log in the given buffer, which must outlive the reader,
+    /// building expressions with the given builder.
+    QueryLogReader(const char *data, size_t size, ExprBuilder *builder);
+
+    /// Return true if the given buffer starts like a binary query log.
+    static bool isQueryLog(const char *data, size_t size);
+
+    /// Read the next query in the log.
+    ///
+    /// \return false at the end of the log or on error (see getError).
+    bool next(QueryLogEntry &entry, QueryLogResult &result);
+
+    /// The reason reading stopped early, or empty.
+    const std::string &getError() const { return error; }
+  };
 }
 
 #endif
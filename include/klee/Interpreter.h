@@ -54,12 +54,16 @@ public:
     bool Optimize;
     bool CheckDivZero;
     bool CheckOvershift;
+    /// The module has been prepared by an earlier run (and cached), so
+    /// it only needs to be indexed for execution.
+    bool Prepared;
 
     ModuleOptions(const std::string& _LibraryDir, 
                   bool _Optimize, bool _CheckDivZero,
                   bool _CheckOvershift)
       : LibraryDir(_LibraryDir), Optimize(_Optimize), 
-        CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift) {}
+        CheckDivZero(_CheckDivZero), CheckOvershift(_CheckOvershift),
+        Prepared(false) {}
   };
 
   enum LogType
@@ -124,6 +128,17 @@ public:
   // for the search. use null to reset.
   virtual void useSeeds(const std::vector<struct KTest *> *seeds) = 0;
 
+  // resume exploration from the states recorded in a checkpoint
+  // directory written by an earlier run of the same program.
+  virtual void useCheckpoint(const std::string &dir) = 0;
+
+  // exchange inputs with fuzzers sharing an AFL-style sync directory:
+  // new entries in the queue of every other instance under dir are
+  // run as seeds while exploring. name is the instance to skip, whose
+  // queue the handler writes to.
+  virtual void useSyncDirectory(const std::string &dir,
+                                const std::string &name) = 0;
+
   virtual void runFunctionAsMain(llvm::Function *f,
                                  int argc,
                                  char **argv,
@@ -283,6 +283,12 @@ namespace klee {
   Solver *createSMTLIBLoggingSolver(Solver *s, std::string path,
                                     int minQueryTimeToLog);
 
+  /// createBinaryLoggingSolver - Create a solver which will forward all
+  /// queries after writing them to the given path in the binary query
+  /// log format (see QueryLogWriter).
+  Solver *createBinaryLoggingSolver(Solver *s, std::string path,
+                                    int minQueryTimeToLog);
+
 
   /// createDummySolver - Create a dummy solver implementation which always
   /// fails.
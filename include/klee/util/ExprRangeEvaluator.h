@@ -37,6 +37,7 @@ public:
   ValueType binaryOr(ValueType &);
   ValueType binaryXor(ValueType &);
   ValueType concat(ValueType &, unsigned width);
+  ValueType extract(uint64_t lowBit, uint64_t maxBit);
   ValueType add(ValueType &, unsigned width);
   ValueType sub(ValueType &, unsigned width);
   ValueType mul(ValueType &, unsigned width);
@@ -120,12 +121,26 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     }
   }
 
+    // Casts
+
+  case Expr::ZExt:
+    return evaluate(cast<CastExpr>(e)->src);
+
+  case Expr::Extract: {
+    const ExtractExpr *ee = cast<ExtractExpr>(e);
+    if (ee->expr->getWidth() > 64)
+      break;
+    return evaluate(ee->expr).extract(ee->offset, ee->offset + ee->width);
+  }
+
     // XXX these should be unrolled to ensure nice inline
   case Expr::Concat: {
     const Expr *ep = e.get();
+    if (ep->getWidth() > 64)
+      break;
     T res(0);
     for (unsigned i=0; i<ep->getNumKids(); i++)
-      res = res.concat(evaluate(ep->getKid(i)),8);
+      res = res.concat(evaluate(ep->getKid(i)), ep->getKid(i)->getWidth());
     return res;
   }
 
@@ -277,7 +292,9 @@ T ExprRangeEvaluator<T>::evaluate(const ref<Expr> &e) {
     break;
   }
 
-  return T(0, bits64::maxValueOfNBits(e->getWidth()));
+  // Values are tracked in 64 bits, wider expressions get the full range.
+  unsigned width = e->getWidth();
+  return T(0, bits64::maxValueOfNBits(width > 64 ? 64 : width));
 }
 
 }
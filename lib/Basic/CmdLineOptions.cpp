@@ -68,6 +68,8 @@ llvm::cl::list<QueryLoggingSolverType> queryLoggingOptions(
         clEnumValN(ALL_SMTLIB,"all:smt2","All queries in .smt2 (SMT-LIBv2) format"),
         clEnumValN(SOLVER_PC,"solver:pc","All queries reaching the solver in .pc (KQuery) format"),
         clEnumValN(SOLVER_SMTLIB,"solver:smt2","All queries reaching the solver in .smt2 (SMT-LIBv2) format"),
+        clEnumValN(ALL_BINARY,"all:bin","All queries in the compact binary format (readable by kleaver)"),
+        clEnumValN(SOLVER_BINARY,"solver:bin","All queries reaching the solver in the compact binary format"),
         clEnumValEnd
 	),
     llvm::cl::CommaSeparated
@@ -20,7 +20,9 @@ namespace klee
                                      std::string querySMT2LogPath,
                                      std::string baseSolverQuerySMT2LogPath,
                                      std::string queryPCLogPath,
-                                     std::string baseSolverQueryPCLogPath)
+                                     std::string baseSolverQueryPCLogPath,
+                                     std::string queryBinaryLogPath,
+                                     std::string baseSolverQueryBinaryLogPath)
 	{
 	  Solver *solver = coreSolver;
 
@@ -42,6 +44,15 @@ namespace klee
 			  << baseSolverQuerySMT2LogPath.c_str() << "\n";
 	  }
 
+	  if (optionIsSet(queryLoggingOptions, SOLVER_BINARY))
+	  {
+		solver = createBinaryLoggingSolver(solver,
+						   baseSolverQueryBinaryLogPath,
+						   MinQueryTimeToLog);
+		llvm::errs() << "Logging queries that reach solver in binary format to "
+			  << baseSolverQueryBinaryLogPath.c_str() << "\n";
+	  }
+
 	  if (UseFastCexSolver)
 		solver = createFastCexSolver(solver);
 
@@ -74,6 +85,14 @@ namespace klee
 			  << querySMT2LogPath.c_str() << "\n";
 	  }
 
+	  if (optionIsSet(queryLoggingOptions, ALL_BINARY))
+	  {
+		solver = createBinaryLoggingSolver(solver, queryBinaryLogPath,
+						   MinQueryTimeToLog);
+		llvm::errs() << "Logging all queries in binary format to "
+			  << queryBinaryLogPath.c_str() << "\n";
+	  }
+
 	  return solver;
 	}
 
@@ -9,9 +9,15 @@
 
 #include "klee/Internal/ADT/KTest.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define KTEST_VERSION 3
 #define KTEST_MAGIC_SIZE 5
@@ -20,47 +26,123 @@
 // for compatibility reasons
 #define BOUT_MAGIC "BOUT\n"
 
+#define KTEST_PACK_VERSION 1
+#define KTEST_PACK_MAGIC "KPACK"
+// magic, version and index offset
+#define KTEST_PACK_HEADER_SIZE (KTEST_MAGIC_SIZE + 4 + 8)
+
 /***/
 
-static int read_uint32(FILE *f, unsigned *value_out) {
-  unsigned char data[4];
-  if (fread(data, 4, 1, f)!=1)
+struct KTestMapping {
+  unsigned char *base;
+  size_t size;
+  int mapped; /* base was mmap'ed, otherwise malloc'ed */
+  unsigned refs;
+};
+
+/* Open the contents of the file at path, mapping them if map is set and
+   the file can be mapped, reading them otherwise. */
+static KTestMapping *mapping_open(const char *path, int map) {
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  KTestMapping *m;
+
+  if (fd < 0)
     return 0;
-  *value_out = (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
-  return 1;
+  if (fstat(fd, &st) < 0 || !(m = (KTestMapping*) calloc(1, sizeof(*m)))) {
+    close(fd);
+    return 0;
+  }
+  m->refs = 1;
+
+  if (map && S_ISREG(st.st_mode) && st.st_size > 0) {
+    void *base = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, 0);
+    if (base != MAP_FAILED) {
+      m->base = (unsigned char*) base;
+      m->size = st.st_size;
+      m->mapped = 1;
+      close(fd);
+      return m;
+    }
+  }
+
+  /* The size is only a hint, pipes and such report none. */
+  size_t capacity = st.st_size > 0 ? (size_t) st.st_size + 1 : 4096;
+  for (;;) {
+    if (m->size == capacity)
+      capacity *= 2;
+    unsigned char *base = (unsigned char*) realloc(m->base, capacity);
+    if (!base)
+      break;
+    m->base = base;
+    ssize_t n = read(fd, m->base + m->size, capacity - m->size);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      if (n < 0)
+        break;
+      close(fd);
+      return m;
+    }
+    m->size += n;
+  }
+
+  free(m->base);
+  free(m);
+  close(fd);
+  return 0;
 }
 
-static int write_uint32(FILE *f, unsigned value) {
-  unsigned char data[4];
-  data[0] = value>>24;
-  data[1] = value>>16;
-  data[2] = value>> 8;
-  data[3] = value>> 0;
-  return fwrite(data, 1, 4, f)==4;
+static void mapping_release(KTestMapping *m) {
+  if (--m->refs)
+    return;
+  if (m->mapped)
+    munmap(m->base, m->size);
+  else
+    free(m->base);
+  free(m);
 }
 
-static int read_string(FILE *f, char **value_out) {
-  unsigned len;
-  if (!read_uint32(f, &len))
-    return 0;
-  *value_out = (char*) malloc(len+1);
-  if (!*value_out)
-    return 0;
-  if (fread(*value_out, len, 1, f)!=1)
+/***/
+
+/* A cursor over a .ktest image in memory. */
+typedef struct {
+  const unsigned char *pos, *end;
+} Reader;
+
+static int get_uint32(Reader *r, unsigned *value_out) {
+  const unsigned char *data = r->pos;
+  if (r->end - r->pos < 4)
     return 0;
-  (*value_out)[len] = 0;
+  *value_out = (((((data[0]<<8) + data[1])<<8) + data[2])<<8) + data[3];
+  r->pos += 4;
   return 1;
 }
 
-static int write_string(FILE *f, const char *value) {
-  unsigned len = strlen(value);
-  if (!write_uint32(f, len))
-    return 0;
-  if (fwrite(value, len, 1, f)!=1)
+static int get_bytes(Reader *r, unsigned len, const unsigned char **out) {
+  if ((size_t) (r->end - r->pos) < len)
     return 0;
+  *out = r->pos;
+  r->pos += len;
   return 1;
 }
 
+static unsigned char *put_uint32(unsigned char *p, unsigned value) {
+  p[0] = value>>24;
+  p[1] = value>>16;
+  p[2] = value>> 8;
+  p[3] = value>> 0;
+  return p + 4;
+}
+
+static unsigned char *put_string(unsigned char *p, const char *value) {
+  unsigned len = strlen(value);
+  p = put_uint32(p, len);
+  memcpy(p, value, len);
+  return p + len;
+}
+
 /***/
 
 
@@ -91,132 +173,184 @@ int kTest_isKTestFile(const char *path) {
   return res;
 }
 
-KTest *kTest_fromFile(const char *path) {
-  FILE *f = fopen(path, "rb");
-  KTest *res = 0;
-  unsigned i, version;
-
-  if (!f) 
-    goto error;
-  if (!kTest_checkHeader(f)) 
-    goto error;
-
-  res = (KTest*) calloc(1, sizeof(*res));
-  if (!res) 
-    goto error;
-
-  if (!read_uint32(f, &version)) 
-    goto error;
-  
-  if (version > kTest_getCurrentVersion())
-    goto error;
-
-  res->version = version;
+/* Walk the .ktest image in [data, data+size), filling in the counts of
+   res. With strings NULL, only check the image and count the bytes its
+   strings need (with their terminators) in *stringBytes; otherwise also
+   fill in the arrays of res, copying the strings to strings and
+   pointing the object bytes into the image. The size of the image is
+   returned in *used. */
+static int kTest_walk(const unsigned char *data, size_t size, KTest *res,
+                      char *strings, size_t *stringBytes, size_t *used) {
+  Reader r = { data, data + size };
+  const unsigned char *magic, *p;
+  unsigned i, len;
+
+  if (!get_bytes(&r, KTEST_MAGIC_SIZE, &magic))
+    return 0;
+  if (memcmp(magic, KTEST_MAGIC, KTEST_MAGIC_SIZE) &&
+      memcmp(magic, BOUT_MAGIC, KTEST_MAGIC_SIZE))
+    return 0;
+  if (!get_uint32(&r, &res->version) ||
+      res->version > kTest_getCurrentVersion())
+    return 0;
 
-  if (!read_uint32(f, &res->numArgs)) 
-    goto error;
-  res->args = (char**) calloc(res->numArgs, sizeof(*res->args));
-  if (!res->args) 
-    goto error;
-  
-  for (i=0; i<res->numArgs; i++)
-    if (!read_string(f, &res->args[i]))
-      goto error;
+  if (!get_uint32(&r, &res->numArgs))
+    return 0;
+  if (!strings)
+    *stringBytes = 0;
+  for (i=0; i<res->numArgs; i++) {
+    if (!get_uint32(&r, &len) || !get_bytes(&r, len, &p))
+      return 0;
+    if (strings) {
+      res->args[i] = strings;
+      memcpy(strings, p, len);
+      strings[len] = 0;
+      strings += len + 1;
+    } else {
+      *stringBytes += len + 1;
+    }
+  }
 
-  if (version >= 2) {
-    if (!read_uint32(f, &res->symArgvs)) 
-      goto error;
-    if (!read_uint32(f, &res->symArgvLen)) 
-      goto error;
+  res->symArgvs = res->symArgvLen = 0;
+  if (res->version >= 2) {
+    if (!get_uint32(&r, &res->symArgvs) || !get_uint32(&r, &res->symArgvLen))
+      return 0;
   }
 
-  if (!read_uint32(f, &res->numObjects))
-    goto error;
-  res->objects = (KTestObject*) calloc(res->numObjects, sizeof(*res->objects));
-  if (!res->objects)
-    goto error;
+  if (!get_uint32(&r, &res->numObjects))
+    return 0;
   for (i=0; i<res->numObjects; i++) {
-    KTestObject *o = &res->objects[i];
-    if (!read_string(f, &o->name))
-      goto error;
-    if (!read_uint32(f, &o->numBytes))
-      goto error;
-    o->bytes = (unsigned char*) malloc(o->numBytes);
-    if (fread(o->bytes, o->numBytes, 1, f)!=1)
-      goto error;
+    const unsigned char *name;
+    unsigned numBytes;
+    if (!get_uint32(&r, &len) || !get_bytes(&r, len, &name) ||
+        !get_uint32(&r, &numBytes) || !get_bytes(&r, numBytes, &p))
+      return 0;
+    if (strings) {
+      KTestObject *o = &res->objects[i];
+      o->name = strings;
+      memcpy(strings, name, len);
+      strings[len] = 0;
+      strings += len + 1;
+      o->numBytes = numBytes;
+      o->bytes = (unsigned char*) p;
+    } else {
+      *stringBytes += len + 1;
+    }
   }
 
-  fclose(f);
+  *used = r.pos - data;
+  return 1;
+}
+
+/* Parse the .ktest image at offset in the mapping into a single block,
+   taking a reference to the mapping. The image may be followed by other
+   data; its size is returned in *used. */
+static KTest *kTest_parse(KTestMapping *m, size_t offset, size_t size,
+                          size_t *used) {
+  const unsigned char *data = m->base + offset;
+  KTest counts, *res;
+  size_t stringBytes;
+  char *block;
+
+  if (!kTest_walk(data, size, &counts, 0, &stringBytes, used))
+    return 0;
 
+  /* The counts are bounded by the size of the image, so this does not
+     overflow. */
+  block = (char*) calloc(1, sizeof(*res) +
+                         counts.numArgs * sizeof(*res->args) +
+                         counts.numObjects * sizeof(*res->objects) +
+                         stringBytes);
+  if (!block)
+    return 0;
+  res = (KTest*) block;
+  res->args = (char**) (block + sizeof(*res));
+  res->objects = (KTestObject*) (res->args + counts.numArgs);
+  kTest_walk(data, size, res, (char*) (res->objects + counts.numObjects),
+             &stringBytes, used);
+
+  res->mapping = m;
+  ++m->refs;
   return res;
- error:
-  if (res) {
-    if (res->args) {
-      for (i=0; i<res->numArgs; i++)
-        if (res->args[i])
-          free(res->args[i]);
-      free(res->args);
-    }
-    if (res->objects) {
-      for (i=0; i<res->numObjects; i++) {
-        KTestObject *bo = &res->objects[i];
-        if (bo->name)
-          free(bo->name);
-        if (bo->bytes)
-          free(bo->bytes);
-      }
-      free(res->objects);
-    }
-    free(res);
-  }
+}
 
-  if (f) fclose(f);
+static KTest *kTest_load(const char *path, int map) {
+  KTestMapping *m = mapping_open(path, map);
+  KTest *res;
+  size_t used;
 
-  return 0;
+  if (!m)
+    return 0;
+  res = kTest_parse(m, 0, m->size, &used);
+  mapping_release(m);
+  return res;
 }
 
-int kTest_toFile(KTest *bo, const char *path) {
-  FILE *f = fopen(path, "wb");
+KTest *kTest_fromFile(const char *path) {
+  return kTest_load(path, 0);
+}
+
+KTest *kTest_mapFile(const char *path) {
+  return kTest_load(path, 1);
+}
+
+static size_t kTest_imageSize(KTest *bo) {
+  size_t size = KTEST_MAGIC_SIZE + 4 + 4 + 4 + 4 + 4;
   unsigned i;
 
-  if (!f) 
-    goto error;
-  if (fwrite(KTEST_MAGIC, strlen(KTEST_MAGIC), 1, f)!=1)
-    goto error;
-  if (!write_uint32(f, KTEST_VERSION))
-    goto error;
-      
-  if (!write_uint32(f, bo->numArgs))
-    goto error;
-  for (i=0; i<bo->numArgs; i++) {
-    if (!write_string(f, bo->args[i]))
-      goto error;
-  }
+  for (i=0; i<bo->numArgs; i++)
+    size += 4 + strlen(bo->args[i]);
+  for (i=0; i<bo->numObjects; i++)
+    size += 4 + strlen(bo->objects[i].name) + 4 + bo->objects[i].numBytes;
+  return size;
+}
 
-  if (!write_uint32(f, bo->symArgvs))
-    goto error;
-  if (!write_uint32(f, bo->symArgvLen))
-    goto error;
-  
-  if (!write_uint32(f, bo->numObjects))
-    goto error;
+/* Write the .ktest image of bo to p, which has kTest_imageSize(bo)
+   bytes. */
+static void kTest_writeImage(KTest *bo, unsigned char *p) {
+  unsigned i;
+
+  memcpy(p, KTEST_MAGIC, KTEST_MAGIC_SIZE);
+  p = put_uint32(p + KTEST_MAGIC_SIZE, KTEST_VERSION);
+
+  p = put_uint32(p, bo->numArgs);
+  for (i=0; i<bo->numArgs; i++)
+    p = put_string(p, bo->args[i]);
+
+  p = put_uint32(p, bo->symArgvs);
+  p = put_uint32(p, bo->symArgvLen);
+
+  p = put_uint32(p, bo->numObjects);
   for (i=0; i<bo->numObjects; i++) {
     KTestObject *o = &bo->objects[i];
-    if (!write_string(f, o->name))
-      goto error;
-    if (!write_uint32(f, o->numBytes))
-      goto error;
-    if (fwrite(o->bytes, o->numBytes, 1, f)!=1)
-      goto error;
+    p = put_string(p, o->name);
+    p = put_uint32(p, o->numBytes);
+    if (o->numBytes)
+      memcpy(p, o->bytes, o->numBytes);
+    p += o->numBytes;
   }
+}
 
-  fclose(f);
+int kTest_toFile(KTest *bo, const char *path) {
+  size_t size = kTest_imageSize(bo);
+  unsigned char *image = (unsigned char*) malloc(size);
+  FILE *f = 0;
+  int ok = 0;
 
-  return 1;
- error:
-  if (f) fclose(f);
-  
-  return 0;
+  /* Build the image first so that it is written in one go. */
+  if (!image)
+    return 0;
+  kTest_writeImage(bo, image);
+
+  f = fopen(path, "wb");
+  if (f) {
+    ok = fwrite(image, size, 1, f)==1;
+    if (fclose(f))
+      ok = 0;
+  }
+  free(image);
+
+  return ok;
 }
 
 unsigned kTest_numBytes(KTest *bo) {
@@ -228,6 +362,11 @@ unsigned kTest_numBytes(KTest *bo) {
 
 void kTest_free(KTest *bo) {
   unsigned i;
+  if (bo->mapping) {
+    mapping_release(bo->mapping);
+    free(bo);
+    return;
+  }
   for (i=0; i<bo->numArgs; i++)
     free(bo->args[i]);
   free(bo->args);
@@ -238,3 +377,231 @@ void kTest_free(KTest *bo) {
   free(bo->objects);
   free(bo);
 }
+
+/***/
+
+struct KTestPack {
+  KTestMapping *mapping;
+  unsigned numTests;
+  uint64_t *offsets;
+};
+
+struct KTestPackWriter {
+  FILE *f;
+  uint64_t offset; /* of the next test */
+  unsigned numTests, capacity;
+  uint64_t *offsets;
+  unsigned char *image;
+  size_t imageCapacity;
+};
+
+static int get_uint64(Reader *r, uint64_t *value_out) {
+  unsigned hi, lo;
+  if (!get_uint32(r, &hi) || !get_uint32(r, &lo))
+    return 0;
+  *value_out = ((uint64_t) hi << 32) | lo;
+  return 1;
+}
+
+static unsigned char *put_uint64(unsigned char *p, uint64_t value) {
+  return put_uint32(put_uint32(p, value >> 32), (unsigned) value);
+}
+
+int kTest_isKTestPack(const char *path) {
+  FILE *f = fopen(path, "rb");
+  char header[KTEST_MAGIC_SIZE];
+  int res;
+
+  if (!f)
+    return 0;
+  res = fread(header, KTEST_MAGIC_SIZE, 1, f)==1 &&
+    !memcmp(header, KTEST_PACK_MAGIC, KTEST_MAGIC_SIZE);
+  fclose(f);
+
+  return res;
+}
+
+KTestPack *kTestPack_open(const char *path) {
+  KTestMapping *m = mapping_open(path, 1);
+  KTestPack *pack = 0;
+  Reader r;
+  const unsigned char *magic;
+  unsigned version, i;
+  uint64_t indexOffset;
+
+  if (!m)
+    return 0;
+  r.pos = m->base;
+  r.end = m->base + m->size;
+  if (!get_bytes(&r, KTEST_MAGIC_SIZE, &magic) ||
+      memcmp(magic, KTEST_PACK_MAGIC, KTEST_MAGIC_SIZE) ||
+      !get_uint32(&r, &version) || version > KTEST_PACK_VERSION ||
+      !get_uint64(&r, &indexOffset))
+    goto error;
+
+  pack = (KTestPack*) calloc(1, sizeof(*pack));
+  if (!pack)
+    goto error;
+  pack->mapping = m;
+
+  if (indexOffset) {
+    if (indexOffset > m->size)
+      goto error;
+    r.pos = m->base + indexOffset;
+    if (!get_uint32(&r, &pack->numTests) ||
+        pack->numTests > (size_t) (r.end - r.pos) / 8)
+      goto error;
+    pack->offsets = (uint64_t*) malloc((pack->numTests + 1) *
+                                       sizeof(*pack->offsets));
+    if (!pack->offsets)
+      goto error;
+    for (i=0; i<pack->numTests; i++)
+      if (!get_uint64(&r, &pack->offsets[i]) ||
+          pack->offsets[i] < KTEST_PACK_HEADER_SIZE ||
+          pack->offsets[i] > indexOffset)
+        goto error;
+    pack->offsets[i] = indexOffset;
+  } else {
+    /* The writer did not finish (klee was killed, say): recover the
+       tests written in full by walking them. */
+    uint64_t offset = KTEST_PACK_HEADER_SIZE;
+    unsigned capacity = 0;
+    for (;;) {
+      KTest counts;
+      size_t stringBytes, used;
+      if (pack->numTests == capacity) {
+        uint64_t *offsets;
+        capacity = capacity ? 2 * capacity : 64;
+        offsets = (uint64_t*) realloc(pack->offsets,
+                                      (capacity + 1) * sizeof(*offsets));
+        if (!offsets)
+          goto error;
+        pack->offsets = offsets;
+      }
+      pack->offsets[pack->numTests] = offset;
+      if (!kTest_walk(m->base + offset, m->size - offset, &counts, 0,
+                      &stringBytes, &used))
+        break;
+      offset += used;
+      ++pack->numTests;
+    }
+  }
+
+  return pack;
+ error:
+  if (pack) {
+    free(pack->offsets);
+    free(pack);
+  }
+  mapping_release(m);
+
+  return 0;
+}
+
+unsigned kTestPack_numTests(KTestPack *pack) {
+  return pack->numTests;
+}
+
+KTest *kTestPack_getTest(KTestPack *pack, unsigned index) {
+  uint64_t offset, end;
+  size_t used;
+
+  if (index >= pack->numTests)
+    return 0;
+  offset = pack->offsets[index];
+  end = pack->offsets[index + 1];
+  if (end < offset)
+    return 0;
+  return kTest_parse(pack->mapping, offset, end - offset, &used);
+}
+
+void kTestPack_close(KTestPack *pack) {
+  mapping_release(pack->mapping);
+  free(pack->offsets);
+  free(pack);
+}
+
+KTestPackWriter *kTestPack_create(const char *path) {
+  KTestPackWriter *w = (KTestPackWriter*) calloc(1, sizeof(*w));
+  unsigned char header[KTEST_PACK_HEADER_SIZE];
+
+  if (!w)
+    return 0;
+  w->f = fopen(path, "wb");
+  if (!w->f) {
+    free(w);
+    return 0;
+  }
+  /* The index offset is filled in by kTestPack_finish. */
+  memcpy(header, KTEST_PACK_MAGIC, KTEST_MAGIC_SIZE);
+  put_uint64(put_uint32(header + KTEST_MAGIC_SIZE, KTEST_PACK_VERSION), 0);
+  if (fwrite(header, sizeof(header), 1, w->f)!=1) {
+    fclose(w->f);
+    free(w);
+    return 0;
+  }
+  w->offset = sizeof(header);
+
+  return w;
+}
+
+int kTestPack_add(KTestPackWriter *w, KTest *bo) {
+  size_t size = kTest_imageSize(bo);
+
+  if (w->numTests == w->capacity) {
+    unsigned capacity = w->capacity ? 2 * w->capacity : 64;
+    uint64_t *offsets = (uint64_t*) realloc(w->offsets,
+                                            capacity * sizeof(*offsets));
+    if (!offsets)
+      return 0;
+    w->offsets = offsets;
+    w->capacity = capacity;
+  }
+  if (size > w->imageCapacity) {
+    unsigned char *image = (unsigned char*) realloc(w->image, size);
+    if (!image)
+      return 0;
+    w->image = image;
+    w->imageCapacity = size;
+  }
+
+  /* Flush every test, so that one left unfinished (klee was killed,
+     say) keeps all the tests added so far. */
+  kTest_writeImage(bo, w->image);
+  if (fwrite(w->image, size, 1, w->f)!=1 || fflush(w->f))
+    return 0;
+  w->offsets[w->numTests++] = w->offset;
+  w->offset += size;
+
+  return 1;
+}
+
+int kTestPack_finish(KTestPackWriter *w) {
+  unsigned char entry[8];
+  unsigned i;
+  int ok;
+
+  put_uint32(entry, w->numTests);
+  ok = fwrite(entry, 4, 1, w->f)==1;
+  for (i=0; ok && i<w->numTests; i++) {
+    put_uint64(entry, w->offsets[i]);
+    ok = fwrite(entry, 8, 1, w->f)==1;
+  }
+
+  /* Only point the header at a complete index. */
+  if (ok && fflush(w->f)==0 &&
+      fseek(w->f, KTEST_MAGIC_SIZE + 4, SEEK_SET)==0) {
+    put_uint64(entry, w->offset);
+    ok = fwrite(entry, 8, 1, w->f)==1;
+  } else {
+    ok = 0;
+  }
+  if (fclose(w->f))
+    ok = 0;
+
+  free(w->offsets);
+  free(w->image);
+  free(w);
+
+  return ok;
+}
@@ -298,8 +298,13 @@ void AddressSpace::copyOutConcretes() {
       ObjectState *os = it->second;
       uint8_t *address = (uint8_t*) (unsigned long) mo->address;
 
-      if (!os->readOnly)
+      // Skip objects whose native memory already holds these contents,
+      // which is most of them unless another state ran in between.
+      if (!os->readOnly && mo->copiedOut != os) {
         memcpy(address, os->concreteStore, mo->size);
+        mo->copiedOut = os;
+        stats::externalCopyBytes += mo->size;
+      }
     }
   }
 }
@@ -315,11 +320,16 @@ bool AddressSpace::copyInConcretes() {
 
       if (memcmp(address, os->concreteStore, mo->size)!=0) {
         if (os->readOnly) {
+          forgetCopiedOut();
           return false;
         } else {
           ObjectState *wos = getWriteable(mo, os);
           memcpy(wos->concreteStore, address, mo->size);
+          mo->copiedOut = wos;
+          stats::externalCopyBytes += mo->size;
         }
+      } else {
+        mo->copiedOut = os;
       }
     }
   }
@@ -327,6 +337,25 @@ bool AddressSpace::copyInConcretes() {
   return true;
 }
 
+void AddressSpace::forgetCopiedOut() {
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
+       it != ie; ++it)
+    it->first->copiedOut = 0;
+}
+
+void AddressSpace::getConcreteRegions(std::vector<ExternalDispatcher::MemoryRegion> &regions) const {
+  for (MemoryMap::iterator it = objects.begin(), ie = objects.end(); 
+       it != ie; ++it) {
+    const MemoryObject *mo = it->first;
+    const ObjectState *os = it->second;
+
+    if (!mo->isUserSpecified && mo->size)
+      regions.push_back(ExternalDispatcher::MemoryRegion(
+                          (void*) (unsigned long) mo->address,
+                          os->concreteStore, mo->size));
+  }
+}
+
 /***/
 
 bool MemoryObjectLT::operator()(const MemoryObject *a, const MemoryObject *b) const {
@@ -10,6 +10,7 @@
 #ifndef KLEE_ADDRESSSPACE_H
 #define KLEE_ADDRESSSPACE_H
 
+#include "ExternalDispatcher.h"
 #include "ObjectHolder.h"
 
 #include "klee/Expr.h"
@@ -35,6 +36,8 @@ namespace klee {
   
   class AddressSpace {
   private:
+    friend class StateOffloader;
+
     /// Epoch counter used to control ownership of objects.
     mutable unsigned cowKey;
 
@@ -113,7 +116,9 @@ namespace klee {
     ObjectState *getWriteable(const MemoryObject *mo, const ObjectState *os);
 
     /// Copy the concrete values of all managed ObjectStates into the
-    /// actual system memory location they were allocated at.
+    /// actual system memory location they were allocated at. Objects
+    /// whose system memory is known to hold their current values
+    /// already are skipped.
     void copyOutConcretes();
 
     /// Copy the concrete values of all managed ObjectStates back from
@@ -123,8 +128,18 @@ namespace klee {
     /// the current concrete values.
     ///
     /// \retval true The copy succeeded. 
-    /// \retval false The copy failed because a read-only object was modified.
+    /// \retval false The copy failed because a read-only object was
+    /// modified; what the system memory holds is then unknown (see
+    /// forgetCopiedOut()).
     bool copyInConcretes();
+
+    /// Forget what the system memory of all managed ObjectStates holds,
+    /// after an external call whose effects were not copied back in.
+    void forgetCopiedOut();
+
+    /// Describe the system memory of all managed ObjectStates, along
+    /// with their concrete values, for an isolated external call.
+    void getConcreteRegions(std::vector<ExternalDispatcher::MemoryRegion> &regions) const;
   };
 } // End klee namespace
 
@@ -13,7 +13,10 @@ using namespace klee;
 
 Statistic stats::allocations("Allocations", "Alloc");
 Statistic stats::coveredInstructions("CoveredInstructions", "Icov");
+Statistic stats::externalCalls("ExternalCalls", "Ext");
+Statistic stats::externalCopyBytes("ExternalCopyBytes", "ExtBytes");
 Statistic stats::falseBranches("FalseBranches", "Bf");
+Statistic stats::fastPathInstructions("FastPathInstructions", "Ifast");
 Statistic stats::forkTime("ForkTime", "Ftime");
 Statistic stats::forks("Forks", "Forks");
 Statistic stats::instructionRealTime("InstructionRealTimes", "Ireal");
@@ -23,6 +26,7 @@ Statistic stats::minDistToReturn("MinDistToReturn", "Rdist");
 Statistic stats::minDistToUncovered("MinDistToUncovered", "UCdist");
 Statistic stats::reachableUncovered("ReachableUncovered", "IuncovReach");
 Statistic stats::resolveTime("ResolveTime", "Rtime");
+Statistic stats::sharedSeedEvaluations("SharedSeedEvaluations", "SeedShared");
 Statistic stats::solverTime("SolverTime", "Stime");
 Statistic stats::states("States", "States");
 Statistic stats::trueBranches("TrueBranches", "Bt");
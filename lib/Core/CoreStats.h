@@ -30,6 +30,21 @@ namespace stats {
   /// The number of process forks.
   extern Statistic forks;
 
+  /// The number of instructions run by the concrete fast path, without
+  /// going back to the searcher.
+  extern Statistic fastPathInstructions;
+
+  /// The number of seed evaluations skipped because the seed agreed with
+  /// another one on every input byte involved.
+  extern Statistic sharedSeedEvaluations;
+
+  /// The number of calls to external functions.
+  extern Statistic externalCalls;
+
+  /// The number of bytes copied between object states and native memory
+  /// around external calls.
+  extern Statistic externalCopyBytes;
+
   /// Number of states, this is a "fake" statistic used by istats, it
   /// isn't normally up-to-date.
   extern Statistic states;
@@ -72,11 +72,15 @@ ExecutionState::ExecutionState(KFunction *kf)
     pc(kf->instructions),
     prevPC(pc),
     queryCost(0.), 
+    recentQueryCost(0.),
     weight(1),
     instsSinceCovNew(0),
     coveredNew(false),
     forkDisabled(false),
-    ptreeNode(0) {
+    ptreeNode(0),
+    steppedInstructions(0),
+    lastScheduled(0),
+    suspended(false) {
   pushFrame(0, kf);
 }
 
@@ -84,7 +88,11 @@ ExecutionState::ExecutionState(const std::vector<ref<Expr> > &assumptions)
   : fakeState(true),
     constraints(assumptions),
     queryCost(0.),
-    ptreeNode(0) {
+    recentQueryCost(0.),
+    ptreeNode(0),
+    steppedInstructions(0),
+    lastScheduled(0),
+    suspended(false) {
 }
 
 ExecutionState::~ExecutionState() {
@@ -109,6 +117,7 @@ ExecutionState::ExecutionState(const ExecutionState& state)
     stack(state.stack),
     constraints(state.constraints),
     queryCost(state.queryCost),
+    recentQueryCost(state.recentQueryCost),
     weight(state.weight),
     addressSpace(state.addressSpace),
     pathOS(state.pathOS),
@@ -118,11 +127,15 @@ ExecutionState::ExecutionState(const ExecutionState& state)
     forkDisabled(state.forkDisabled),
     coveredLines(state.coveredLines),
     ptreeNode(state.ptreeNode),
+    steppedInstructions(state.steppedInstructions),
+    lastScheduled(state.lastScheduled),
+    suspended(false),
     symbolics(state.symbolics),
     arrayNames(state.arrayNames),
     shadowObjects(state.shadowObjects),
     incomingBBIndex(state.incomingBBIndex)
 {
+  assert(!state.suspended && "cannot copy a suspended state");
   for (unsigned int i=0; i<symbolics.size(); i++)
     symbolics[i].first->refCount++;
 }
@@ -188,7 +201,7 @@ llvm::raw_ostream &klee::operator<<(llvm::raw_ostream &os, const MemoryMap &mm)
   return os;
 }
 
-bool ExecutionState::merge(const ExecutionState &b) {
+bool ExecutionState::merge(const ExecutionState &b, unsigned maxSelects) {
   if (DebugLogStateMerge)
     llvm::errs() << "-- attempting merge of A:" << this << " with B:" << &b
                  << "--\n";
@@ -291,6 +304,36 @@ bool ExecutionState::merge(const ExecutionState &b) {
     return false;
   }
   
+  // Every register and byte that differs becomes a select over the path
+  // condition, which all later queries touching it will have to carry.
+  if (maxSelects) {
+    unsigned numSelects = 0;
+    std::vector<StackFrame>::const_iterator itA = stack.begin();
+    std::vector<StackFrame>::const_iterator itB = b.stack.begin();
+    for (; itA!=stack.end(); ++itA, ++itB) {
+      for (unsigned i=0; i<itA->kf->numRegisters; i++) {
+        const ref<Expr> &av = itA->locals[i].value;
+        const ref<Expr> &bv = itB->locals[i].value;
+        if (!av.isNull() && !bv.isNull() && av != bv)
+          ++numSelects;
+      }
+    }
+    for (std::set<const MemoryObject*>::iterator it = mutated.begin(), 
+           ie = mutated.end(); it != ie; ++it) {
+      const MemoryObject *mo = *it;
+      const ObjectState *os = addressSpace.findObject(mo);
+      const ObjectState *otherOS = b.addressSpace.findObject(mo);
+      for (unsigned i=0; i<mo->size && numSelects<=maxSelects; i++)
+        if (os->read8(i) != otherOS->read8(i))
+          ++numSelects;
+    }
+    if (numSelects > maxSelects) {
+      if (DebugLogStateMerge)
+        llvm::errs() << "\t\ttoo many selects: " << numSelects << "\n";
+      return false;
+    }
+  }
+
   // merge stack
 
   ref<Expr> inA = ConstantExpr::alloc(1, Expr::Bool);
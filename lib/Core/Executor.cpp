@@ -19,6 +19,7 @@
 #include "Searcher.h"
 #include "SeedInfo.h"
 #include "SpecialFunctionHandler.h"
+#include "StateOffloader.h"
 #include "StatsTracker.h"
 #include "TimingSolver.h"
 #include "UserSearcher.h"
@@ -181,6 +182,16 @@ namespace {
   cl::opt<bool>
   AllExternalWarnings("all-external-warnings");
 
+  cl::opt<bool>
+  ConcreteFastPath("concrete-fast-path",
+                   cl::init(false),
+                   cl::desc("Run on through a basic block without going back to the searcher while its instructions only see concrete values (default=off)"));
+
+  cl::opt<bool>
+  IsolateExternalCalls("isolate-external-calls",
+                       cl::init(false),
+                       cl::desc("Run external calls in a forked child process, copying back only their effect on the memory of the calling state (default=off)"));
+
   cl::opt<bool>
   OnlyOutputStatesCoveringNew("only-output-states-covering-new",
                               cl::init(false),
@@ -208,6 +219,10 @@ namespace {
   OnlySeed("only-seed", 
            cl::desc("Stop execution after seeding is done without doing regular search."));
  
+  cl::opt<bool>
+  Concolic("concolic",
+           cl::desc("Follow the seeds without checking the feasibility of the other side of each branch, and solve for new inputs taking those sides once the seeds are done (see --concolic-generations)."));
+
   cl::opt<bool>
   AllowSeedExtension("allow-seed-extension", 
                      cl::desc("Allow extra (unbound) values to become symbolic during seeding."));
@@ -267,6 +282,11 @@ namespace {
             cl::desc("Inhibit forking at memory cap (vs. random terminate) (default=on)"),
             cl::init(true));
 
+  cl::opt<bool>
+  OffloadStates("offload-states",
+                cl::desc("Suspend least recently run states to disk at the memory cap (vs. terminate) (default=off)"),
+                cl::init(false));
+
   cl::opt<unsigned>
   MaxForksTerminate("max-forks-terminate",
             cl::desc("Only fork this many times and then dump states (default=-1 (off))"),
@@ -291,9 +311,14 @@ Executor::Executor(const InterpreterOptions &opts,
     symPathWriter(0),
     specialFunctionHandler(0),
     processTree(0),
+    offloader(OffloadStates ? new StateOffloader(ih) : 0),
     replayOut(0),
     replayPath(0),    
     usingSeeds(0),
+    numSeeds(0),
+    replayingCheckpoint(false),
+    checkpointing(false),
+    syncRoot(0),
     atMemoryLimit(false),
     inhibitForking(false),
     haltExecution(false),
@@ -343,7 +368,9 @@ Executor::Executor(const InterpreterOptions &opts,
                          interpreterHandler->getOutputFilename(ALL_QUERIES_SMT2_FILE_NAME),
                          interpreterHandler->getOutputFilename(SOLVER_QUERIES_SMT2_FILE_NAME),
                          interpreterHandler->getOutputFilename(ALL_QUERIES_PC_FILE_NAME),
-                         interpreterHandler->getOutputFilename(SOLVER_QUERIES_PC_FILE_NAME));
+                         interpreterHandler->getOutputFilename(SOLVER_QUERIES_PC_FILE_NAME),
+                         interpreterHandler->getOutputFilename(ALL_QUERIES_BINARY_FILE_NAME),
+                         interpreterHandler->getOutputFilename(SOLVER_QUERIES_BINARY_FILE_NAME));
   
   this->solver = new TimingSolver(solver, EqualitySubstitution);
 
@@ -387,6 +414,20 @@ Executor::~Executor() {
   delete externalDispatcher;
   if (processTree)
     delete processTree;
+  if (offloader)
+    delete offloader;
+  while (!resumeSeeds.empty()) {
+    kTest_free(resumeSeeds.back());
+    resumeSeeds.pop_back();
+  }
+  while (!concolicInputs.empty()) {
+    kTest_free(concolicInputs.back());
+    concolicInputs.pop_back();
+  }
+  while (!syncInputs.empty()) {
+    kTest_free(syncInputs.back());
+    syncInputs.pop_back();
+  }
   if (specialFunctionHandler)
     delete specialFunctionHandler;
   if (statsTracker)
@@ -623,6 +664,115 @@ void Executor::initializeGlobals(ExecutionState &state) {
   }
 }
 
+/// Partition seeds into groups which agree on every input byte read by
+/// the given expressions, and so evaluate them identically. On return
+/// seedGroup[i] is the group of seed i and leaders[g] is the first seed
+/// in group g, so callers need to evaluate each expression once per
+/// group rather than once per seed.
+///
+/// Only the bytes read at constant indices are compared; an array read
+/// at a symbolic index is compared whole.
+static void groupSeeds(const std::vector<SeedInfo> &seeds,
+                       const std::vector< ref<Expr> > &exprs,
+                       std::vector<unsigned> &seedGroup,
+                       std::vector<unsigned> &leaders) {
+  seedGroup.assign(seeds.size(), 0);
+  leaders.clear();
+  if (seeds.empty())
+    return;
+  if (seeds.size() == 1) {
+    leaders.push_back(0);
+    return;
+  }
+
+  std::vector< ref<ReadExpr> > reads;
+  for (unsigned i = 0, e = exprs.size(); i != e; ++i)
+    findReads(exprs[i], /*visitUpdates=*/true, reads);
+  std::set< std::pair<const Array*, unsigned> > bytes;
+  std::set<const Array*> wholeArrays;
+  for (unsigned i = 0, e = reads.size(); i != e; ++i) {
+    const Array *array = reads[i]->updates.root;
+    if (array->isConstantArray())
+      continue;
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(reads[i]->index))
+      bytes.insert(std::make_pair(array, (unsigned) CE->getZExtValue()));
+    else
+      wholeArrays.insert(array);
+  }
+  if (bytes.empty() && wholeArrays.empty()) {
+    leaders.push_back(0);
+    return;
+  }
+
+  std::map<std::vector<unsigned char>, unsigned> groups;
+  std::vector<unsigned char> key;
+  for (unsigned i = 0, e = seeds.size(); i != e; ++i) {
+    const Assignment::bindings_ty &bindings = seeds[i].assignment.bindings;
+    key.clear();
+    // A byte the seed leaves unbound is kept apart from every value.
+    for (std::set< std::pair<const Array*, unsigned> >::iterator
+           it = bytes.begin(), ie = bytes.end(); it != ie; ++it) {
+      if (wholeArrays.count(it->first))
+        continue;
+      Assignment::bindings_ty::const_iterator bit =
+        bindings.find(it->first);
+      if (bit == bindings.end() || it->second >= bit->second.size()) {
+        key.push_back(0);
+      } else {
+        key.push_back(1);
+        key.push_back(bit->second[it->second]);
+      }
+    }
+    for (std::set<const Array*>::iterator it = wholeArrays.begin(),
+           ie = wholeArrays.end(); it != ie; ++it) {
+      Assignment::bindings_ty::const_iterator bit = bindings.find(*it);
+      if (bit == bindings.end()) {
+        key.push_back(0);
+        continue;
+      }
+      // Seed values may be shorter than the array, so the length is part
+      // of the key.
+      uint32_t size = bit->second.size();
+      key.push_back(1);
+      key.insert(key.end(), (const unsigned char*) &size,
+                 (const unsigned char*) &size + sizeof size);
+      key.insert(key.end(), bit->second.begin(), bit->second.end());
+    }
+
+    std::pair<std::map<std::vector<unsigned char>, unsigned>::iterator, bool>
+      res = groups.insert(std::make_pair(key, leaders.size()));
+    if (res.second)
+      leaders.push_back(i);
+    seedGroup[i] = res.first->second;
+  }
+  stats::sharedSeedEvaluations += seeds.size() - leaders.size();
+}
+
+/// Evaluate a condition under the seeds alone: True or False if they all
+/// agree, Unknown if they do not. Returns false if a seed leaves the
+/// condition symbolic.
+static bool getSeedsOutcome(std::vector<SeedInfo> &seeds,
+                            ref<Expr> condition,
+                            Solver::Validity &result) {
+  std::vector<unsigned> seedGroup, leaders;
+  groupSeeds(seeds, std::vector< ref<Expr> >(1, condition),
+             seedGroup, leaders);
+  bool trueSeed = false, falseSeed = false;
+  for (unsigned g = 0, e = leaders.size(); g != e; ++g) {
+    ref<Expr> value = seeds[leaders[g]].assignment.evaluate(condition);
+    ConstantExpr *CE = dyn_cast<ConstantExpr>(value);
+    if (!CE)
+      return false;
+    if (CE->isTrue())
+      trueSeed = true;
+    else
+      falseSeed = true;
+  }
+  result = trueSeed ? (falseSeed ? Solver::Unknown : Solver::True)
+                    : Solver::False;
+  return trueSeed || falseSeed;
+}
+
 void Executor::branch(ExecutionState &state, 
                       const std::vector< ref<Expr> > &conditions,
                       std::vector<ExecutionState*> &result) {
@@ -647,10 +797,9 @@ void Executor::branch(ExecutionState &state,
     for (unsigned i=1; i<N; ++i) {
       ExecutionState *es = result[theRNG.getInt32() % i];
       ExecutionState *ns = es->branch();
-      addedStates.insert(ns);
+      addedStates.push_back(ns);
       result.push_back(ns);
-      es->ptreeNode->data = 0;
-      std::pair<PTree::Node*,PTree::Node*> res = 
+      std::pair<PTree::NodeId,PTree::NodeId> res = 
         processTree->split(es->ptreeNode, ns, es);
       ns->ptreeNode = res.first;
       es->ptreeNode = res.second;
@@ -670,20 +819,27 @@ void Executor::branch(ExecutionState &state,
     // Assume each seed only satisfies one condition (necessarily true
     // when conditions are mutually exclusive and their conjunction is
     // a tautology).
-    for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
-           siie = seeds.end(); siit != siie; ++siit) {
+    std::vector<unsigned> seedGroup, leaders;
+    groupSeeds(seeds, conditions, seedGroup, leaders);
+    std::vector<unsigned> groupCondition(leaders.size());
+    for (unsigned g = 0, e = leaders.size(); g != e; ++g) {
+      Assignment &assignment = seeds[leaders[g]].assignment;
       unsigned i;
       for (i=0; i<N; ++i) {
         ref<ConstantExpr> res;
         bool success = 
-          solver->getValue(state, siit->assignment.evaluate(conditions[i]), 
-                           res);
+          solver->getValue(state, assignment.evaluate(conditions[i]), res);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
         if (res->isTrue())
           break;
       }
-      
+      groupCondition[g] = i;
+    }
+
+    for (unsigned j = 0, e = seeds.size(); j != e; ++j) {
+      unsigned i = groupCondition[seedGroup[j]];
+
       // If we didn't find a satisfying condition randomly pick one
       // (the seed will be patched).
       if (i==N)
@@ -691,12 +847,18 @@ void Executor::branch(ExecutionState &state,
 
       // Extra check in case we're replaying seeds with a max-fork
       if (result[i])
-        seedMap[result[i]].push_back(*siit);
+        seedMap[result[i]].push_back(seeds[j]);
+      else
+        --numSeeds;
     }
 
-    if (OnlyReplaySeeds) {
+    if (OnlyReplaySeeds || replayingCheckpoint || Concolic ||
+        (!seeds.empty() && seeds[0].followOnly)) {
       for (unsigned i=0; i<N; ++i) {
         if (result[i] && !seedMap.count(result[i])) {
+          if (Concolic && !seeds.empty())
+            queueConcolicQuery(*result[i], Expr::createIsZero(conditions[i]),
+                               i, seeds[0].input);
           terminateState(*result[i]);
           result[i] = NULL;
         }
@@ -743,12 +905,28 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     }
   }
 
-  double timeout = coreSolverTimeout;
-  if (isSeeding)
-    timeout *= it->second.size();
-  solver->setTimeout(timeout);
-  bool success = solver->evaluate(current, condition, res);
-  solver->setTimeout(0);
+  bool success;
+  if (isSeeding && Concolic && !isa<ConstantExpr>(condition) &&
+      getSeedsOutcome(it->second, condition, res)) {
+    // Trust the seeds instead of asking the solver; a side which no seed
+    // takes is queued to be solved for later.
+    success = true;
+    if (res == Solver::True) {
+      queueConcolicQuery(current, condition, 1, it->second[0].input);
+      addConstraint(current, condition);
+    } else if (res == Solver::False) {
+      ref<Expr> negated = Expr::createIsZero(condition);
+      queueConcolicQuery(current, negated, 0, it->second[0].input);
+      addConstraint(current, negated);
+    }
+  } else {
+    double timeout = coreSolverTimeout;
+    if (isSeeding)
+      timeout *= it->second.size();
+    solver->setTimeout(timeout);
+    success = solver->evaluate(current, condition, res);
+    solver->setTimeout(0);
+  }
   if (!success) {
     current.pc = current.prevPC;
     terminateStateEarly(current, "Query timed out (fork).");
@@ -808,18 +986,24 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
 	  haltExecution = true;
   }
 
-  // Fix branch in only-replay-seed mode, if we don't have both true
-  // and false seeds.
+  // Fix branch in only-replay-seed mode (or when following inputs
+  // imported from the sync directory), if we don't have both true and
+  // false seeds.
   if (isSeeding && 
-      (current.forkDisabled || OnlyReplaySeeds) && 
+      (current.forkDisabled || OnlyReplaySeeds || replayingCheckpoint ||
+       (!it->second.empty() && it->second[0].followOnly)) &&
       res == Solver::Unknown) {
     bool trueSeed=false, falseSeed=false;
+    std::vector<unsigned> seedGroup, leaders;
+    groupSeeds(it->second, std::vector< ref<Expr> >(1, condition),
+               seedGroup, leaders);
     // Is seed extension still ok here?
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    for (unsigned g = 0, e = leaders.size(); g != e; ++g) {
       ref<ConstantExpr> res;
       bool success = 
-        solver->getValue(current, siit->assignment.evaluate(condition), res);
+        solver->getValue(current,
+                         it->second[leaders[g]].assignment.evaluate(condition),
+                         res);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
       if (res->isTrue()) {
@@ -869,7 +1053,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
     ++stats::forks;
 
     falseState = trueState->branch();
-    addedStates.insert(falseState);
+    addedStates.push_back(falseState);
 
     if (RandomizeFork && theRNG.getBool())
       std::swap(trueState, falseState);
@@ -879,28 +1063,36 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       it->second.clear();
       std::vector<SeedInfo> &trueSeeds = seedMap[trueState];
       std::vector<SeedInfo> &falseSeeds = seedMap[falseState];
-      for (std::vector<SeedInfo>::iterator siit = seeds.begin(), 
-             siie = seeds.end(); siit != siie; ++siit) {
+      std::vector<unsigned> seedGroup, leaders;
+      groupSeeds(seeds, std::vector< ref<Expr> >(1, condition),
+                 seedGroup, leaders);
+      std::vector<bool> groupIsTrue(leaders.size());
+      for (unsigned g = 0, e = leaders.size(); g != e; ++g) {
         ref<ConstantExpr> res;
         bool success = 
-          solver->getValue(current, siit->assignment.evaluate(condition), res);
+          solver->getValue(current,
+                           seeds[leaders[g]].assignment.evaluate(condition),
+                           res);
         assert(success && "FIXME: Unhandled solver failure");
         (void) success;
-        if (res->isTrue()) {
-          trueSeeds.push_back(*siit);
+        groupIsTrue[g] = res->isTrue();
+      }
+      for (unsigned j = 0, e = seeds.size(); j != e; ++j) {
+        if (groupIsTrue[seedGroup[j]]) {
+          trueSeeds.push_back(seeds[j]);
         } else {
-          falseSeeds.push_back(*siit);
+          falseSeeds.push_back(seeds[j]);
         }
       }
       
       bool swapInfo = false;
       if (trueSeeds.empty()) {
         if (&current == trueState) swapInfo = true;
-        seedMap.erase(trueState);
+        removeSeeds(trueState);
       }
       if (falseSeeds.empty()) {
         if (&current == falseState) swapInfo = true;
-        seedMap.erase(falseState);
+        removeSeeds(falseState);
       }
       if (swapInfo) {
         std::swap(trueState->coveredNew, falseState->coveredNew);
@@ -908,8 +1100,7 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
       }
     }
 
-    current.ptreeNode->data = 0;
-    std::pair<PTree::Node*, PTree::Node*> res =
+    std::pair<PTree::NodeId, PTree::NodeId> res =
       processTree->split(current.ptreeNode, falseState, trueState);
     falseState->ptreeNode = res.first;
     trueState->ptreeNode = res.second;
@@ -941,6 +1132,15 @@ Executor::fork(ExecutionState &current, ref<Expr> condition, bool isInternal) {
   }
 }
 
+void Executor::removeSeeds(ExecutionState *state) {
+  std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
+    seedMap.find(state);
+  if (it != seedMap.end()) {
+    numSeeds -= it->second.size();
+    seedMap.erase(it);
+  }
+}
+
 void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   if (ConstantExpr *CE = dyn_cast<ConstantExpr>(condition)) {
     if (!CE->isTrue())
@@ -952,16 +1152,26 @@ void Executor::addConstraint(ExecutionState &state, ref<Expr> condition) {
   std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it = 
     seedMap.find(&state);
   if (it != seedMap.end()) {
-    bool warn = false;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    std::vector<SeedInfo> &seeds = it->second;
+    std::vector<unsigned> seedGroup, leaders;
+    groupSeeds(seeds, std::vector< ref<Expr> >(1, condition),
+               seedGroup, leaders);
+    std::vector<bool> groupViolates(leaders.size());
+    for (unsigned g = 0, e = leaders.size(); g != e; ++g) {
       bool res;
       bool success = 
-        solver->mustBeFalse(state, siit->assignment.evaluate(condition), res);
+        solver->mustBeFalse(state,
+                            seeds[leaders[g]].assignment.evaluate(condition),
+                            res);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
-      if (res) {
-        siit->patchSeed(state, condition, solver);
+      groupViolates[g] = res;
+    }
+
+    bool warn = false;
+    for (unsigned j = 0, e = seeds.size(); j != e; ++j) {
+      if (groupViolates[seedGroup[j]]) {
+        seeds[j].patchSeed(state, condition, solver);
         warn = true;
       }
     }
@@ -1130,11 +1340,13 @@ void Executor::executeGetValue(ExecutionState &state,
     bindLocal(target, state, value);
   } else {
     std::set< ref<Expr> > values;
-    for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
-           siie = it->second.end(); siit != siie; ++siit) {
+    std::vector<unsigned> seedGroup, leaders;
+    groupSeeds(it->second, std::vector< ref<Expr> >(1, e), seedGroup, leaders);
+    for (unsigned g = 0, ge = leaders.size(); g != ge; ++g) {
       ref<ConstantExpr> value;
       bool success = 
-        solver->getValue(state, siit->assignment.evaluate(e), value);
+        solver->getValue(state, it->second[leaders[g]].assignment.evaluate(e),
+                         value);
       assert(success && "FIXME: Unhandled solver failure");
       (void) success;
       values.insert(value);
@@ -1170,6 +1382,7 @@ void Executor::stepInstruction(ExecutionState &state) {
     statsTracker->stepInstruction(state);
 
   ++stats::instructions;
+  ++state.steppedInstructions;
   state.prevPC = state.pc;
   ++state.pc;
 
@@ -1429,7 +1642,63 @@ static inline const llvm::fltSemantics * fpWidthToSemantics(unsigned width) {
   }
 }
 
+/// Whether a register holds a constant; registers not assigned yet do not.
+static bool isConcreteValue(const ref<Expr> &value) {
+  return !value.isNull() && isa<ConstantExpr>(value);
+}
+
+bool Executor::canContinueConcretely(ExecutionState &state,
+                                     KInstruction *ki) {
+  if (haltExecution || !addedStates.empty() || !removedStates.empty())
+    return false;
+
+  Instruction *i = ki->inst;
+  if (isa<TerminatorInst>(i) || isa<CallInst>(i))
+    return false;
+  if (ki->width && !isConcreteValue(getDestCell(state, ki).value))
+    return false;
+
+  // Calls are left to the normal path; their operands are also laid out
+  // differently.
+  KInstruction *next = state.pc;
+  if (isa<CallInst>(next->inst))
+    return false;
+  // The first instruction past the phi nodes of a block is where states
+  // are merged (see AutoMergingSearcher), so the searcher must see it.
+  if (isa<PHINode>(i) && !isa<PHINode>(next->inst))
+    return false;
+  // A phi node only reads the value of the edge taken; the others may not
+  // be computed yet (the back edge of a loop entered for the first time).
+  if (isa<PHINode>(next->inst)) {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 0)
+    unsigned j = state.incomingBBIndex;
+#else
+    unsigned j = state.incomingBBIndex * 2;
+#endif
+    return next->operands[j] == -1 ||
+           isConcreteValue(eval(next, j, state).value);
+  }
+  for (unsigned j = 0, e = next->inst->getNumOperands(); j != e; ++j)
+    if (next->operands[j] != -1 && !isConcreteValue(eval(next, j, state).value))
+      return false;
+
+  return true;
+}
+
 void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
+  // Integer arithmetic and comparisons over constants use the evaluation
+  // decoded with the instruction.
+  if (ki->concreteOp) {
+    ConstantExpr *left = dyn_cast<ConstantExpr>(eval(ki, 0, state).value);
+    ConstantExpr *right = dyn_cast<ConstantExpr>(eval(ki, 1, state).value);
+    if (left && right) {
+      uint64_t value = ki->concreteOp(left->getZExtValue(),
+                                      right->getZExtValue());
+      bindLocal(ki, state, ConstantExpr::create(value, ki->width));
+      return;
+    }
+  }
+
   Instruction *i = ki->inst;
   switch (i->getOpcode()) {
     // Control flow
@@ -2009,38 +2278,33 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     // Conversion
   case Instruction::Trunc: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> result = ExtractExpr::create(eval(ki, 0, state).value,
                                            0,
-                                           getWidthForLLVMType(ci->getType()));
+                                           ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::ZExt: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> result = ZExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
   case Instruction::SExt: {
-    CastInst *ci = cast<CastInst>(i);
     ref<Expr> result = SExtExpr::create(eval(ki, 0, state).value,
-                                        getWidthForLLVMType(ci->getType()));
+                                        ki->width);
     bindLocal(ki, state, result);
     break;
   }
 
   case Instruction::IntToPtr: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width pType = getWidthForLLVMType(ci->getType());
+    Expr::Width pType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     bindLocal(ki, state, ZExtExpr::create(arg, pType));
     break;
   } 
   case Instruction::PtrToInt: {
-    CastInst *ci = cast<CastInst>(i);
-    Expr::Width iType = getWidthForLLVMType(ci->getType());
+    Expr::Width iType = ki->width;
     ref<Expr> arg = eval(ki, 0, state).value;
     bindLocal(ki, state, ZExtExpr::create(arg, iType));
     break;
@@ -2154,8 +2418,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPTrunc: {
-    FPTruncInst *fi = cast<FPTruncInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > arg->getWidth())
@@ -2175,8 +2438,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPExt: {
-    FPExtInst *fi = cast<FPExtInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                         "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || arg->getWidth() > resultType)
@@ -2195,8 +2457,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToUI: {
-    FPToUIInst *fi = cast<FPToUIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2216,8 +2477,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::FPToSI: {
-    FPToSIInst *fi = cast<FPToSIInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     if (!fpWidthToSemantics(arg->getWidth()) || resultType > 64)
@@ -2237,8 +2497,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::UIToFP: {
-    UIToFPInst *fi = cast<UIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -2253,8 +2512,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
   }
 
   case Instruction::SIToFP: {
-    SIToFPInst *fi = cast<SIToFPInst>(i);
-    Expr::Width resultType = getWidthForLLVMType(fi->getType());
+    Expr::Width resultType = ki->width;
     ref<ConstantExpr> arg = toConstant(state, eval(ki, 0, state).value,
                                        "floating point");
     const llvm::fltSemantics *semantics = fpWidthToSemantics(resultType);
@@ -2397,7 +2655,7 @@ void Executor::executeInstruction(ExecutionState &state, KInstruction *ki) {
 
     ref<Expr> agg = eval(ki, 0, state).value;
 
-    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, getWidthForLLVMType(i->getType()));
+    ref<Expr> result = ExtractExpr::create(agg, kgepi->offset*8, ki->width);
 
     bindLocal(ki, state, result);
     break;
@@ -2426,23 +2684,67 @@ void Executor::updateStates(ExecutionState *current) {
   states.insert(addedStates.begin(), addedStates.end());
   addedStates.clear();
   
-  for (std::set<ExecutionState*>::iterator
+  for (llvm::SmallVectorImpl<ExecutionState*>::iterator
          it = removedStates.begin(), ie = removedStates.end();
        it != ie; ++it) {
     ExecutionState *es = *it;
     std::set<ExecutionState*>::iterator it2 = states.find(es);
     assert(it2!=states.end());
     states.erase(it2);
-    std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
-      seedMap.find(es);
-    if (it3 != seedMap.end())
-      seedMap.erase(it3);
+    removeSeeds(es);
+    if (es->suspended) {
+      offloader->discard(*es);
+      suspendedSolutions.erase(es);
+    }
     processTree->remove(es->ptreeNode);
     delete es;
   }
   removedStates.clear();
 }
 
+static bool isColderState(const ExecutionState *a, const ExecutionState *b) {
+  return a->lastScheduled < b->lastScheduled;
+}
+
+bool Executor::offloadColdStates(ExecutionState &current, unsigned mbs) {
+  std::vector<ExecutionState*> candidates;
+  for (std::set<ExecutionState*>::iterator it = states.begin(),
+         ie = states.end(); it != ie; ++it)
+    if (*it != &current && !(*it)->suspended)
+      candidates.push_back(*it);
+  std::sort(candidates.begin(), candidates.end(), isColderState);
+
+  uint64_t target = (uint64_t) mbs << 20, released = 0;
+  unsigned numSuspended = 0;
+  for (std::vector<ExecutionState*>::iterator it = candidates.begin(),
+         ie = candidates.end(); it != ie && released < target; ++it) {
+    // The path of a suspended state does not change, so its checkpoint
+    // input can be computed once, while its memory is still here.
+    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
+    if (checkpointing && !getSymbolicSolution(**it, out))
+      continue;
+    if (uint64_t bytes = offloader->suspend(**it)) {
+      released += bytes;
+      ++numSuspended;
+      if (checkpointing)
+        suspendedSolutions[*it].swap(out);
+    }
+  }
+
+  if (numSuspended)
+    klee_message("suspended %u states (%u MB) to disk (over memory cap), "
+                 "%u states suspended in total", numSuspended,
+                 (unsigned) (released >> 20), offloader->getNumSuspended());
+  return released >= target;
+}
+
+void Executor::ensureResident(ExecutionState &state) {
+  if (state.suspended) {
+    offloader->resume(state);
+    suspendedSolutions.erase(&state);
+  }
+}
+
 template <typename TypeIt>
 void Executor::computeOffsets(KGEPInstruction *kgepi, TypeIt ib, TypeIt ie) {
   ref<ConstantExpr> constantOffset =
@@ -2514,55 +2816,102 @@ void Executor::run(ExecutionState &initialState) {
 
   states.insert(&initialState);
 
-  if (usingSeeds) {
+  if (!resumeStatsFile.empty())
+    restoreCheckpointStatistics();
+
+  // Inputs imported from the sync directory while exploring are run
+  // from a copy of the initial state, kept aside for the whole run: it is
+  // in neither states nor the process tree, so no searcher can pick it.
+  // The inputs already there are seeds of the initial state.
+  if (!syncDirectory.empty()) {
+    syncRoot = initialState.branch();
+    syncRoot->ptreeNode = PTree::None;
+    syncCorpus(&initialState);
+  }
+
+  if (usingSeeds || !resumeSeeds.empty() || seedMap.count(&initialState)) {
     std::vector<SeedInfo> &v = seedMap[&initialState];
+    replayingCheckpoint = !resumeSeeds.empty();
     
-    for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
-           ie = usingSeeds->end(); it != ie; ++it)
-      v.push_back(SeedInfo(*it));
-
-    int lastNumSeeds = usingSeeds->size()+10;
+    if (usingSeeds)
+      for (std::vector<KTest*>::const_iterator it = usingSeeds->begin(), 
+             ie = usingSeeds->end(); it != ie; ++it)
+        v.push_back(SeedInfo(*it));
+
+    for (unsigned i = 0; i != resumeSeeds.size(); ++i) {
+      v.push_back(SeedInfo(resumeSeeds[i]));
+      v.back().resumeAt = resumeTargets[i];
+    }
+    numSeeds = v.size();
+
+    // In concolic mode each generation of inputs is run from a copy of
+    // the initial state, kept aside (outside of states) until seeding
+    // is done.
+    ExecutionState *concolicRoot = 0;
+    unsigned generation = 0;
+    if (Concolic) {
+      concolicRoot = initialState.branch();
+      std::pair<PTree::NodeId, PTree::NodeId> res =
+        processTree->split(initialState.ptreeNode, concolicRoot, &initialState);
+      concolicRoot->ptreeNode = res.first;
+      initialState.ptreeNode = res.second;
+    }
+
+    int lastNumSeeds = v.size()+10;
     double lastTime, startTime = lastTime = util::getWallTime();
     ExecutionState *lastState = 0;
     while (!seedMap.empty()) {
-      if (haltExecution) goto dump;
+      if (haltExecution) break;
 
       std::map<ExecutionState*, std::vector<SeedInfo> >::iterator it = 
         seedMap.upper_bound(lastState);
       if (it == seedMap.end())
         it = seedMap.begin();
       lastState = it->first;
-      unsigned numSeeds = it->second.size();
+      unsigned stateSeeds = it->second.size();
       ExecutionState &state = *lastState;
       KInstruction *ki = state.pc;
       stepInstruction(state);
 
       executeInstruction(state, ki);
-      processTimers(&state, MaxInstructionTime * numSeeds);
+      processTimers(&state, MaxInstructionTime * stateSeeds);
+      if (replayingCheckpoint && !isRemovedState(&state))
+        releaseResumedState(state);
+      if (syncRoot && !isRemovedState(&state))
+        releaseSyncedState(state);
       updateStates(&state);
 
       if ((stats::instructions % 1000) == 0) {
-        int numSeeds = 0, numStates = 0;
-        for (std::map<ExecutionState*, std::vector<SeedInfo> >::iterator
-               it = seedMap.begin(), ie = seedMap.end();
-             it != ie; ++it) {
-          numSeeds += it->second.size();
-          numStates++;
-        }
+        int remainingSeeds = numSeeds, numStates = seedMap.size();
         double time = util::getWallTime();
         if (SeedTime>0. && time > startTime + SeedTime) {
           klee_warning("seed time expired, %d seeds remain over %d states",
-                       numSeeds, numStates);
+                       remainingSeeds, numStates);
           break;
-        } else if (numSeeds<=lastNumSeeds-10 ||
+        } else if (remainingSeeds<=lastNumSeeds-10 ||
                    time >= lastTime+10) {
           lastTime = time;
-          lastNumSeeds = numSeeds;          
+          lastNumSeeds = remainingSeeds;          
           klee_message("%d seeds remaining over: %d states", 
-                       numSeeds, numStates);
+                       remainingSeeds, numStates);
         }
       }
+
+      // Every checkpointed state is back once its seeds are all gone;
+      // later seeds (concolic inputs) may fork as usual.
+      if (seedMap.empty())
+        replayingCheckpoint = false;
+      if (seedMap.empty() && concolicRoot)
+        startConcolicGeneration(*concolicRoot, ++generation);
+    }
+    replayingCheckpoint = false;
+
+    if (concolicRoot) {
+      processTree->remove(concolicRoot->ptreeNode);
+      delete concolicRoot;
     }
+    if (haltExecution)
+      goto dump;
 
     klee_message("seeding done (%d states remain)", (int) states.size());
 
@@ -2580,24 +2929,45 @@ void Executor::run(ExecutionState &initialState) {
 
   searcher = constructUserSearcher(*this);
 
-  searcher->update(0, states, std::set<ExecutionState*>());
+  {
+    llvm::SmallVector<ExecutionState*, 8> initialStates(states.begin(),
+                                                        states.end()), none;
+    searcher->update(0, initialStates, none);
+  }
 
   while (!states.empty() && !haltExecution) {
     ExecutionState &state = searcher->selectState();
+    ensureResident(state);
+    state.lastScheduled = stats::instructions;
+    uint64_t startInstructions = stats::instructions;
     KInstruction *ki = state.pc;
     stepInstruction(state);
 
     executeInstruction(state, ki);
+    if (ConcreteFastPath) {
+      while (canContinueConcretely(state, ki)) {
+        ki = state.pc;
+        stepInstruction(state);
+        executeInstruction(state, ki);
+        ++stats::fastPathInstructions;
+      }
+    }
     processTimers(&state, MaxInstructionTime);
+    if (syncRoot && !isRemovedState(&state))
+      releaseSyncedState(state);
 
     if (MaxMemory) {
-      if ((stats::instructions & 0xFFFF) == 0) {
+      if ((stats::instructions >> 16) != (startInstructions >> 16)) {
         // We need to avoid calling GetMallocUsage() often because it
         // is O(elts on freelist). This is really bad since we start
         // to pummel the freelist once we hit the memory cap.
         unsigned mbs = util::GetTotalMallocUsage() >> 20;
         if (mbs > MaxMemory) {
-          if (mbs > MaxMemory + 100) {
+          // Prefer swapping cold states out; only kill if that could
+          // not bring usage back under the cap.
+          bool relieved =
+            offloader && offloadColdStates(state, mbs - MaxMemory);
+          if (mbs > MaxMemory + 100 && !relieved) {
             // just guess at how many to kill
             unsigned numStates = states.size();
             unsigned toKill = std::max(1U, numStates - numStates*MaxMemory/mbs);
@@ -2644,6 +3014,9 @@ void Executor::run(ExecutionState &initialState) {
     }
     updateStates(0);
   }
+
+  delete syncRoot;
+  syncRoot = 0;
 }
 
 std::string Executor::getAddressInfo(ExecutionState &state, 
@@ -2704,17 +3077,16 @@ void Executor::terminateState(ExecutionState &state) {
 
   interpreterHandler->incPathsExplored();
 
-  std::set<ExecutionState*>::iterator it = addedStates.find(&state);
+  llvm::SmallVectorImpl<ExecutionState*>::iterator it =
+    std::find(addedStates.begin(), addedStates.end(), &state);
   if (it==addedStates.end()) {
     state.pc = state.prevPC;
 
-    removedStates.insert(&state);
+    if (!isRemovedState(&state))
+      removedStates.push_back(&state);
   } else {
     // never reached searcher, just delete immediately
-    std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it3 = 
-      seedMap.find(&state);
-    if (it3 != seedMap.end())
-      seedMap.erase(it3);
+    removeSeeds(&state);
     addedStates.erase(it);
     processTree->remove(state.ptreeNode);
     delete &state;
@@ -2723,6 +3095,9 @@ void Executor::terminateState(ExecutionState &state) {
 
 void Executor::terminateStateEarly(ExecutionState &state, 
                                    const Twine &message) {
+  // Computing the test case copies the state, so it must be in memory;
+  // this covers the memory-cap kill path and --dump-states-on-halt.
+  ensureResident(state);
   if (!OnlyOutputStatesCoveringNew || state.coveredNew ||
       (AlwaysOutputSeeds && seedMap.count(&state)))
     interpreterHandler->processTestCase(state, (message + "\n").str().c_str(),
@@ -2731,6 +3106,7 @@ void Executor::terminateStateEarly(ExecutionState &state,
 }
 
 void Executor::terminateStateOnExit(ExecutionState &state) {
+  ensureResident(state);
   if (!OnlyOutputStatesCoveringNew || state.coveredNew || 
       (AlwaysOutputSeeds && seedMap.count(&state)))
     interpreterHandler->processTestCase(state, 0, 0);
@@ -2783,6 +3159,7 @@ void Executor::terminateStateOnError(ExecutionState &state,
                                      const llvm::Twine &messaget,
                                      const char *suffix,
                                      const llvm::Twine &info) {
+  ensureResident(state);
   std::string message = messaget.str();
   static std::set< std::pair<Instruction*, std::string> > emittedErrors;
   Instruction * lastInst;
@@ -2874,6 +3251,7 @@ void Executor::callExternalFunction(ExecutionState &state,
     }
   }
 
+  ++stats::externalCalls;
   state.addressSpace.copyOutConcretes();
 
   if (!SuppressExternalWarnings) {
@@ -2894,8 +3272,18 @@ void Executor::callExternalFunction(ExecutionState &state,
       klee_warning_once(function, "%s", os.str().c_str());
   }
   
-  bool success = externalDispatcher->executeCall(function, target->inst, args);
+  bool success;
+  if (IsolateExternalCalls) {
+    std::vector<ExternalDispatcher::MemoryRegion> regions;
+    state.addressSpace.getConcreteRegions(regions);
+    success = externalDispatcher->executeCallIsolated(function, target->inst,
+                                                      args, regions);
+  } else {
+    success = externalDispatcher->executeCall(function, target->inst, args);
+  }
   if (!success) {
+    // The call may have written part of the memory before failing.
+    state.addressSpace.forgetCopiedOut();
     terminateStateOnError(state, "failed external call: " + function->getName(),
                           "external.err");
     return;
@@ -3140,8 +3528,7 @@ void Executor::executeMemoryOperation(ExecutionState &state,
                                       ref<Expr> address,
                                       ref<Expr> value /* undef if read */,
                                       KInstruction *target /* undef if write */) {
-  Expr::Width type = (isWrite ? value->getWidth() : 
-                     getWidthForLLVMType(target->inst->getType()));
+  Expr::Width type = (isWrite ? value->getWidth() : target->width);
   unsigned bytes = Expr::getMinBytesForWidth(type);
 
   if (SimplifySymIndices) {
@@ -3284,6 +3671,10 @@ void Executor::executeMakeSymbolic(ExecutionState &state,
       for (std::vector<SeedInfo>::iterator siit = it->second.begin(), 
              siie = it->second.end(); siit != siie; ++siit) {
         SeedInfo &si = *siit;
+        if (si.external) {
+          si.bindRawInput(mo, array);
+          continue;
+        }
         KTestObject *obj = si.getNextInput(mo, NamedSeedMatching);
 
         if (!obj) {
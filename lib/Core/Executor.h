@@ -21,8 +21,10 @@
 #include "klee/Internal/Module/KInstruction.h"
 #include "klee/Internal/Module/KModule.h"
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/Twine.h"
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <map>
@@ -67,6 +69,7 @@ namespace klee {
   class SeedInfo;
   class SpecialFunctionHandler;
   struct StackFrame;
+  class StateOffloader;
   class StatsTracker;
   class TimingSolver;
   class TreeStreamWriter;
@@ -86,6 +89,8 @@ class Executor : public Interpreter {
   friend class WeightedRandomSearcher;
   friend class SpecialFunctionHandler;
   friend class StatsTracker;
+  friend class CheckpointTimer;
+  friend class SyncTimer;
 
 public:
   class Timer {
@@ -116,16 +121,23 @@ private:
   std::vector<TimerInfo*> timers;
   PTree *processTree;
 
+  /// When non-null, cold states are suspended to disk instead of being
+  /// killed when the memory cap is reached.
+  StateOffloader *offloader;
+
   /// Used to track states that have been added during the current
-  /// instructions step. 
+  /// instructions step. Only a handful of states change per step, so
+  /// these are kept in inline storage and searched linearly.
   /// \invariant \ref addedStates is a subset of \ref states. 
   /// \invariant \ref addedStates and \ref removedStates are disjoint.
-  std::set<ExecutionState*> addedStates;
+  /// \invariant \ref addedStates contains no duplicates.
+  llvm::SmallVector<ExecutionState*, 8> addedStates;
   /// Used to track states that have been removed during the current
   /// instructions step. 
   /// \invariant \ref removedStates is a subset of \ref states. 
   /// \invariant \ref addedStates and \ref removedStates are disjoint.
-  std::set<ExecutionState*> removedStates;
+  /// \invariant \ref removedStates contains no duplicates.
+  llvm::SmallVector<ExecutionState*, 8> removedStates;
 
   /// When non-empty the Executor is running in "seed" mode. The
   /// states in this map will be executed in an arbitrary order
@@ -135,6 +147,10 @@ private:
   /// happens with other states (that don't satisfy the seeds) depends
   /// on as-yet-to-be-determined flags.
   std::map<ExecutionState*, std::vector<SeedInfo> > seedMap;
+
+  /// The number of seeds in \ref seedMap, kept up to date as seeds are
+  /// dropped so that seeding progress can be reported without a scan.
+  unsigned numSeeds;
   
   /// Map of globals to their representative memory object.
   std::map<const llvm::GlobalValue*, MemoryObject*> globalObjects;
@@ -160,6 +176,57 @@ private:
   /// drive execution.
   const std::vector<struct KTest *> *usingSeeds;  
 
+  /// Inputs driving execution back to the states of a checkpoint (see
+  /// useCheckpoint()), and the path length at which each of those states
+  /// was recorded. Owned by the executor.
+  std::vector<struct KTest *> resumeSeeds;
+  std::vector<uint64_t> resumeTargets;
+  /// Statistic values recorded with the checkpoint being resumed.
+  std::string resumeStatsFile;
+  /// Set while the checkpointed states are being replayed, during which
+  /// only the paths followed by their inputs are kept.
+  bool replayingCheckpoint;
+  /// Set when checkpoints are written (--checkpoint-interval).
+  bool checkpointing;
+  /// Test inputs of the states suspended while checkpointing, computed
+  /// as they were suspended so that a checkpoint needs not resume them.
+  std::map<const ExecutionState*,
+           std::vector< std::pair<std::string,
+                                  std::vector<unsigned char> > > >
+    suspendedSolutions;
+
+  /// A branch side which no seed took in concolic mode, to be solved
+  /// for a new input once the current seeds are done.
+  struct ConcolicQuery {
+    /// The path constraints at the branch.
+    std::vector< ref<Expr> > constraints;
+    /// The side taken by the seeds; the query asks for its negation.
+    ref<Expr> taken;
+    /// The symbolic objects of the state at the branch, in order.
+    std::vector<std::string> names;
+    std::vector<const Array*> objects;
+    /// A seed which took the branch, whose values are kept for objects
+    /// made symbolic later on.
+    const struct KTest *seed;
+  };
+  std::vector<ConcolicQuery> concolicQueries;
+  /// The branch sides already queued, identified by instruction and
+  /// target index, so that each is negated at most once.
+  std::set< std::pair<const KInstruction*, unsigned> > concolicBranches;
+  /// Inputs generated in concolic mode. Owned by the executor.
+  std::vector<struct KTest *> concolicInputs;
+
+  /// The sync directory shared with fuzzers, and the name of this
+  /// instance in it (see useSyncDirectory()); empty if not syncing.
+  std::string syncDirectory, syncName;
+  /// The queue entries already imported, by path.
+  std::set<std::string> syncImported;
+  /// Inputs imported from the sync directory. Owned by the executor.
+  std::vector<struct KTest *> syncInputs;
+  /// A copy of the initial state, kept outside of states and of the
+  /// process tree, from which imported inputs are run.
+  ExecutionState *syncRoot;
+
   /// Disables forking, instead a random path is chosen. Enabled as
   /// needed to control memory usage. \see fork()
   bool atMemoryLimit;
@@ -184,6 +251,12 @@ private:
   
   void executeInstruction(ExecutionState &state, KInstruction *ki);
 
+  /// Return true if, having just executed ki, the state may go on to its
+  /// next instruction without rescheduling: it stayed in the same basic
+  /// block, nothing forked or terminated, and the next instruction only
+  /// sees concrete values.
+  bool canContinueConcretely(ExecutionState &state, KInstruction *ki);
+
   void printFileLine(ExecutionState &state, KInstruction *ki);
 
   void run(ExecutionState &initialState);
@@ -200,6 +273,20 @@ private:
 
   void stepInstruction(ExecutionState &state);
   void updateStates(ExecutionState *current);
+  /// Return true if the state has been terminated during the current
+  /// instruction step.
+  bool isRemovedState(const ExecutionState *state) const {
+    return std::find(removedStates.begin(), removedStates.end(), state) !=
+      removedStates.end();
+  }
+  /// Suspend least recently run states until roughly \a mbs megabytes
+  /// have been released, never touching \a current.
+  ///
+  /// \return true iff that much memory was released.
+  bool offloadColdStates(ExecutionState &current, unsigned mbs);
+  /// Bring back the memory contents of \a state if it was suspended.
+  /// Needed before a state is run, merged, copied or terminated.
+  void ensureResident(ExecutionState &state);
   void transferToBasicBlock(llvm::BasicBlock *dst, 
 			    llvm::BasicBlock *src,
 			    ExecutionState &state);
@@ -293,6 +380,9 @@ private:
   /// validity checks, and seed patching.
   void addConstraint(ExecutionState &state, ref<Expr> condition);
 
+  /// Remove the seeds of the given state from \ref seedMap, if any.
+  void removeSeeds(ExecutionState *state);
+
   // Called on [for now] concrete reads, replaces constant with a symbolic
   // Used for testing.
   ref<Expr> replaceReadWithSymbolic(ExecutionState &state, ref<Expr> e);
@@ -395,6 +485,36 @@ private:
   void initTimers();
   void processTimers(ExecutionState *current,
                      double maxInstTime);
+
+  /// Write the inputs reaching every live state, together with the
+  /// current statistics, to the checkpoint directory.
+  void writeCheckpoint();
+  /// Restore the statistics recorded with the checkpoint being resumed.
+  void restoreCheckpointStatistics();
+  /// Hand a state replaying a checkpoint over to the searcher once it
+  /// has reached the point at which it was recorded.
+  void releaseResumedState(ExecutionState &state);
+
+  /// In concolic mode, queue a query for the negation of the given
+  /// branch side, taken by the seeds of the state, unless that side has
+  /// already been queued. seed is one of those seeds.
+  void queueConcolicQuery(const ExecutionState &state, ref<Expr> taken,
+                          unsigned index, const struct KTest *seed);
+  /// Solve the queued concolic queries and start the next generation,
+  /// running the resulting inputs as seeds of a copy of root. Returns
+  /// false if there are no new inputs to run.
+  bool startConcolicGeneration(ExecutionState &root, unsigned generation);
+  /// Solve a concolic query for the values of its objects.
+  bool solveConcolicQuery(const ConcolicQuery &q,
+                          std::vector< std::vector<unsigned char> > &values);
+
+  /// Import the new entries of the other queues in the sync directory,
+  /// as seeds of initialState if given (before exploring), or else
+  /// followed from a copy of syncRoot.
+  void syncCorpus(ExecutionState *initialState = 0);
+  /// Stop following an imported input once the state running it has
+  /// covered new code, handing it over to the searcher.
+  void releaseSyncedState(ExecutionState &state);
                 
 public:
   Executor(const InterpreterOptions &opts, InterpreterHandler *ie);
@@ -433,6 +553,14 @@ public:
     usingSeeds = seeds;
   }
 
+  virtual void useCheckpoint(const std::string &dir);
+
+  virtual void useSyncDirectory(const std::string &dir,
+                                const std::string &name) {
+    syncDirectory = dir;
+    syncName = name;
+  }
+
   virtual void runFunctionAsMain(llvm::Function *f,
                                  int argc,
                                  char **argv,
@@ -0,0 +1,221 @@
+//===-- ExecutorCheckpoint.cpp --------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A checkpoint records, for every live state, a concrete input which
+// drives execution down the path of that state, and the number of
+// instructions along that path. Resuming replays those inputs as seeds
+// (dropping every path not followed by one) and hands each replayed
+// state to the searcher once it is back where it was recorded.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Common.h"
+
+#include "CoreStats.h"
+#include "Executor.h"
+#include "PTree.h"
+#include "SeedInfo.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Interpreter.h"
+#include "klee/Statistics.h"
+#include "klee/Internal/ADT/KTest.h"
+#include "klee/Internal/Module/InstructionInfoTable.h"
+#include "klee/Internal/Module/KModule.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace llvm;
+using namespace klee;
+
+void Executor::writeCheckpoint() {
+  std::string dir = interpreterHandler->getOutputFilename("checkpoint");
+  if (mkdir(dir.c_str(), 0775) < 0 && errno != EEXIST) {
+    klee_warning("unable to create checkpoint directory %s: %s",
+                 dir.c_str(), strerror(errno));
+    return;
+  }
+
+  // States added during the current step are live but not yet in
+  // states, while states removed during it still are.
+  std::vector<ExecutionState*> live;
+  for (std::set<ExecutionState*>::iterator it = states.begin(),
+         ie = states.end(); it != ie; ++it)
+    if (!isRemovedState(*it))
+      live.push_back(*it);
+  live.insert(live.end(), addedStates.begin(), addedStates.end());
+
+  std::string indexStr;
+  llvm::raw_string_ostream index(indexStr);
+  unsigned numWritten = 0;
+  for (std::vector<ExecutionState*>::iterator it = live.begin(),
+         ie = live.end(); it != ie; ++it) {
+    ExecutionState &state = **it;
+    std::vector< std::pair<std::string, std::vector<unsigned char> > > out;
+    if (state.suspended) {
+      // Computed when the state was suspended (see offloadColdStates()).
+      out = suspendedSolutions.find(&state)->second;
+    } else if (!getSymbolicSolution(state, out)) {
+      klee_warning("unable to checkpoint state, it will not be resumed");
+      continue;
+    }
+
+    KTest b;
+    b.numArgs = 0;
+    b.args = 0;
+    b.symArgvs = 0;
+    b.symArgvLen = 0;
+    b.numObjects = out.size();
+    b.objects = new KTestObject[b.numObjects];
+    for (unsigned i=0; i<b.numObjects; i++) {
+      KTestObject *o = &b.objects[i];
+      o->name = const_cast<char*>(out[i].first.c_str());
+      o->numBytes = out[i].second.size();
+      o->bytes = out[i].second.empty() ? 0 : &out[i].second[0];
+    }
+
+    char name[32];
+    sprintf(name, "state%06u.ktest", ++numWritten);
+    bool ok = kTest_toFile(&b, (dir + "/" + name).c_str());
+    delete[] b.objects;
+    if (!ok) {
+      klee_warning("unable to write checkpoint state, it will not be resumed");
+      --numWritten;
+      continue;
+    }
+
+    index << name << " " << state.steppedInstructions << "\n";
+  }
+
+  std::ofstream statsFile((dir + "/stats").c_str());
+  StatisticManager &sm = *theStatisticManager;
+  for (unsigned i=0; i<sm.getNumStatistics(); i++) {
+    Statistic &s = sm.getStatistic(i);
+    statsFile << "* " << s.getName() << " " << sm.getValue(s) << "\n";
+  }
+  if (sm.hasIndexedStats()) {
+    for (unsigned id=0, e=kmodule->infos->getMaxID(); id!=e; ++id) {
+      for (unsigned i=0; i<sm.getNumStatistics(); i++) {
+        Statistic &s = sm.getStatistic(i);
+        if (uint64_t value = sm.getIndexedValue(s, id))
+          statsFile << id << " " << s.getName() << " " << value << "\n";
+      }
+    }
+  }
+  statsFile.close();
+
+  // The index is what makes a checkpoint valid; replace it last so an
+  // interrupted checkpoint leaves the previous one usable.
+  std::string indexPath = dir + "/states";
+  {
+    std::ofstream indexFile((indexPath + ".tmp").c_str());
+    indexFile << index.str();
+  }
+  if (rename((indexPath + ".tmp").c_str(), indexPath.c_str()) < 0) {
+    klee_warning("unable to write checkpoint index %s: %s",
+                 indexPath.c_str(), strerror(errno));
+    return;
+  }
+
+  klee_message("checkpointed %u states to %s", numWritten, dir.c_str());
+}
+
+void Executor::useCheckpoint(const std::string &dir) {
+  std::string indexPath = dir + "/states";
+  std::ifstream indexFile(indexPath.c_str());
+  if (!indexFile)
+    klee_error("unable to open checkpoint index: %s", indexPath.c_str());
+
+  std::string name;
+  uint64_t target;
+  while (indexFile >> name >> target) {
+    KTest *input = kTest_fromFile((dir + "/" + name).c_str());
+    if (!input)
+      klee_error("unable to open checkpoint state: %s/%s",
+                 dir.c_str(), name.c_str());
+    resumeSeeds.push_back(input);
+    resumeTargets.push_back(target);
+  }
+  resumeStatsFile = dir + "/stats";
+
+  klee_message("resuming %u states from checkpoint %s",
+               (unsigned) resumeSeeds.size(), dir.c_str());
+}
+
+void Executor::restoreCheckpointStatistics() {
+  std::ifstream statsFile(resumeStatsFile.c_str());
+  if (!statsFile) {
+    klee_warning("unable to open checkpoint statistics: %s",
+                 resumeStatsFile.c_str());
+    return;
+  }
+
+  StatisticManager &sm = *theStatisticManager;
+  unsigned maxID = kmodule->infos->getMaxID();
+  std::string index, name;
+  uint64_t value;
+  while (statsFile >> index >> name >> value) {
+    Statistic *s = sm.getStatisticByName(name);
+    // The state count is maintained from the live states.
+    if (!s || s == &stats::states)
+      continue;
+    if (index == "*") {
+      sm.setValue(*s, value);
+    } else if (sm.hasIndexedStats()) {
+      unsigned id = atoi(index.c_str());
+      if (id < maxID)
+        sm.setIndexedValue(*s, id, value);
+    }
+  }
+}
+
+void Executor::releaseResumedState(ExecutionState &state) {
+  std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it =
+    seedMap.find(&state);
+  if (it == seedMap.end())
+    return;
+
+  std::vector<SeedInfo> pending;
+  bool reached = false;
+  for (std::vector<SeedInfo>::iterator siit = it->second.begin(),
+         siie = it->second.end(); siit != siie; ++siit) {
+    if (siit->resumeAt && siit->resumeAt <= state.steppedInstructions) {
+      reached = true;
+    } else {
+      pending.push_back(*siit);
+    }
+  }
+  if (!reached)
+    return;
+
+  if (pending.empty()) {
+    removeSeeds(&state);
+    return;
+  }
+  numSeeds -= it->second.size() - pending.size();
+
+  // Other checkpointed states share this path so far; leave a copy
+  // here for the searcher and keep replaying the rest.
+  ExecutionState *ns = state.branch();
+  addedStates.push_back(ns);
+  std::pair<PTree::NodeId, PTree::NodeId> res =
+    processTree->split(state.ptreeNode, ns, &state);
+  ns->ptreeNode = res.first;
+  state.ptreeNode = res.second;
+  it->second.swap(pending);
+}
@@ -0,0 +1,260 @@
+//===-- ExecutorConcolic.cpp ----------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// In concolic mode the seeds decide every branch: the executor follows
+// them without asking the solver whether the other side is feasible,
+// and queues each side no seed took (once per branch) as a query. When
+// the seeds are done the queries are solved, possibly by several worker
+// processes, and the solutions are run as the next generation of seeds
+// from a copy of the initial state.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Common.h"
+
+#include "Executor.h"
+#include "PTree.h"
+#include "SeedInfo.h"
+#include "CoreStats.h"
+#include "TimingSolver.h"
+
+#include "klee/CommandLine.h"
+#include "klee/Constraints.h"
+#include "klee/ExecutionState.h"
+#include "klee/Solver.h"
+#include "klee/TimerStatIncrementer.h"
+#include "klee/Internal/ADT/KTest.h"
+#include "klee/Internal/Module/KInstruction.h"
+
+#include "llvm/Support/CommandLine.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace klee;
+
+namespace {
+  cl::opt<unsigned>
+  ConcolicGenerations("concolic-generations",
+                      cl::desc("Stop concolic execution after the given number of generations of new inputs (default=0 (off))"),
+                      cl::init(0));
+
+  cl::opt<unsigned>
+  ConcolicJobs("concolic-jobs",
+               cl::desc("Solve the queries of each concolic generation in the given number of worker processes (default=1)"),
+               cl::init(1));
+}
+
+/// Build a seed from a solution for the objects of a concolic query.
+/// Objects made symbolic after the branch keep the values of the seed
+/// which reached it.
+static KTest *createConcolicInput(const std::vector<std::string> &names,
+                                  const std::vector< std::vector<unsigned char> >
+                                    &values,
+                                  const KTest *seed) {
+  unsigned numObjects = names.size();
+  if (seed && seed->numObjects > numObjects)
+    numObjects = seed->numObjects;
+
+  KTest *input = (KTest*) calloc(1, sizeof *input);
+  input->numObjects = numObjects;
+  input->objects = (KTestObject*) calloc(numObjects, sizeof *input->objects);
+  for (unsigned i = 0; i != numObjects; ++i) {
+    KTestObject *o = &input->objects[i];
+    const char *name;
+    const unsigned char *bytes;
+    if (i < names.size()) {
+      name = names[i].c_str();
+      o->numBytes = values[i].size();
+      bytes = values[i].empty() ? 0 : &values[i][0];
+    } else {
+      name = seed->objects[i].name;
+      o->numBytes = seed->objects[i].numBytes;
+      bytes = seed->objects[i].bytes;
+    }
+    o->name = strdup(name);
+    o->bytes = (unsigned char*) malloc(o->numBytes ? o->numBytes : 1);
+    if (o->numBytes)
+      memcpy(o->bytes, bytes, o->numBytes);
+  }
+  return input;
+}
+
+static void writeSolution(FILE *f, uint32_t index,
+                          const std::vector< std::vector<unsigned char> >
+                            &values) {
+  uint32_t numObjects = values.size();
+  fwrite(&index, sizeof index, 1, f);
+  fwrite(&numObjects, sizeof numObjects, 1, f);
+  for (unsigned i = 0; i != numObjects; ++i) {
+    uint32_t size = values[i].size();
+    fwrite(&size, sizeof size, 1, f);
+    if (size)
+      fwrite(&values[i][0], 1, size, f);
+  }
+}
+
+static bool readSolution(FILE *f, uint32_t &index,
+                         std::vector< std::vector<unsigned char> > &values) {
+  uint32_t numObjects;
+  if (fread(&index, sizeof index, 1, f) != 1 ||
+      fread(&numObjects, sizeof numObjects, 1, f) != 1)
+    return false;
+  values.resize(numObjects);
+  for (unsigned i = 0; i != numObjects; ++i) {
+    uint32_t size;
+    if (fread(&size, sizeof size, 1, f) != 1)
+      return false;
+    values[i].resize(size);
+    if (size && fread(&values[i][0], 1, size, f) != size)
+      return false;
+  }
+  return true;
+}
+
+void Executor::queueConcolicQuery(const ExecutionState &state,
+                                  ref<Expr> taken, unsigned index,
+                                  const KTest *seed) {
+  const KInstruction *ki = state.prevPC;
+  if (!concolicBranches.insert(std::make_pair(ki, index)).second)
+    return;
+
+  concolicQueries.push_back(ConcolicQuery());
+  ConcolicQuery &q = concolicQueries.back();
+  q.constraints.assign(state.constraints.begin(), state.constraints.end());
+  q.taken = taken;
+  for (unsigned i = 0; i != state.symbolics.size(); ++i) {
+    q.names.push_back(state.symbolics[i].first->name);
+    q.objects.push_back(state.symbolics[i].second);
+  }
+  q.seed = seed;
+}
+
+bool Executor::solveConcolicQuery(const ConcolicQuery &q,
+                                  std::vector< std::vector<unsigned char> >
+                                    &values) {
+  // A solution satisfies the constraints but not the side taken. It is
+  // solved through the TimingSolver, like any other query, for the
+  // solver time statistics; the state only holds the constraints.
+  ExecutionState tmp(q.constraints);
+  ref<Expr> other = tmp.constraints.simplifyExpr(Expr::createIsZero(q.taken));
+  if (ConstantExpr *CE = dyn_cast<ConstantExpr>(other)) {
+    if (CE->isFalse())
+      return false;
+  } else {
+    tmp.addConstraint(other);
+  }
+  return solver->getInitialValues(tmp, q.objects, values);
+}
+
+bool Executor::startConcolicGeneration(ExecutionState &root,
+                                       unsigned generation) {
+  std::vector<ConcolicQuery> queries;
+  queries.swap(concolicQueries);
+  if (queries.empty() ||
+      (ConcolicGenerations && generation > ConcolicGenerations))
+    return false;
+
+  unsigned jobs = std::max(1U, (unsigned) ConcolicJobs);
+  if (jobs > 1 && !queryLoggingOptions.empty()) {
+    klee_warning_once(0, "query logs cannot be shared with worker processes, "
+                      "solving concolic queries in one process");
+    jobs = 1;
+  }
+  jobs = std::min(jobs, (unsigned) queries.size());
+
+  std::vector< std::vector< std::vector<unsigned char> > >
+    solutions(queries.size());
+  std::vector<bool> solved(queries.size());
+  solver->setTimeout(coreSolverTimeout);
+  if (jobs == 1) {
+    for (unsigned i = 0, e = queries.size(); i != e; ++i)
+      solved[i] = solveConcolicQuery(queries[i], solutions[i]);
+  } else {
+    // Worker k solves every jobs'th query starting at k and writes the
+    // solutions to its own temporary file. The solver state is copied
+    // into each worker, so the workers do not warm each other's caches.
+    std::vector<FILE*> outputs(jobs);
+    std::vector<pid_t> workers(jobs, -1);
+    for (unsigned k = 0; k != jobs; ++k) {
+      outputs[k] = tmpfile();
+      if (outputs[k])
+        workers[k] = fork();
+      if (workers[k] == 0) {
+        for (unsigned i = k, e = queries.size(); i < e; i += jobs) {
+          std::vector< std::vector<unsigned char> > values;
+          if (solveConcolicQuery(queries[i], values))
+            writeSolution(outputs[k], i, values);
+        }
+        fflush(outputs[k]);
+        _exit(0);
+      }
+      if (workers[k] < 0) {
+        klee_warning("unable to start concolic worker: %s", strerror(errno));
+        for (unsigned i = k, e = queries.size(); i < e; i += jobs)
+          solved[i] = solveConcolicQuery(queries[i], solutions[i]);
+      }
+    }
+
+    // The workers' solver time is not seen by this process; count the
+    // time spent waiting for them instead.
+    TimerStatIncrementer timer(stats::solverTime);
+    for (unsigned k = 0; k != jobs; ++k) {
+      if (workers[k] > 0) {
+        int status;
+        while (waitpid(workers[k], &status, 0) < 0 && errno == EINTR)
+          ;
+        rewind(outputs[k]);
+        uint32_t i;
+        std::vector< std::vector<unsigned char> > values;
+        while (readSolution(outputs[k], i, values) && i < queries.size()) {
+          solved[i] = true;
+          solutions[i].swap(values);
+        }
+      }
+      if (outputs[k])
+        fclose(outputs[k]);
+    }
+  }
+  solver->setTimeout(0);
+
+  std::vector<KTest*> inputs;
+  for (unsigned i = 0, e = queries.size(); i != e; ++i)
+    if (solved[i])
+      inputs.push_back(createConcolicInput(queries[i].names, solutions[i],
+                                           queries[i].seed));
+
+  klee_message("concolic generation %u: %u new inputs from %u queries",
+               generation, (unsigned) inputs.size(),
+               (unsigned) queries.size());
+  if (inputs.empty())
+    return false;
+
+  ExecutionState *es = root.branch();
+  std::pair<PTree::NodeId, PTree::NodeId> res =
+    processTree->split(root.ptreeNode, es, &root);
+  es->ptreeNode = res.first;
+  root.ptreeNode = res.second;
+  states.insert(es);
+
+  std::vector<SeedInfo> &seeds = seedMap[es];
+  for (unsigned i = 0, e = inputs.size(); i != e; ++i) {
+    seeds.push_back(SeedInfo(inputs[i]));
+    concolicInputs.push_back(inputs[i]);
+  }
+  numSeeds += inputs.size();
+  return true;
+}
@@ -0,0 +1,145 @@
+//===-- ExecutorSync.cpp --------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Corpus sync with fuzzers sharing an AFL-style sync directory, where
+// every instance keeps the inputs it found interesting in
+// <sync dir>/<instance>/queue. The entries of the other instances are
+// raw inputs. Those found at the start are seeds of the initial state;
+// each later batch is run from a copy of the initial state, following
+// the inputs without forking until they reach code which was not covered
+// before, from where the states are explored as usual.
+// Exporting the tests of this instance is up to the handler.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Common.h"
+
+#include "Executor.h"
+#include "PTree.h"
+#include "SeedInfo.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Internal/ADT/KTest.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace klee;
+
+/// Read a raw input as a test with a single object.
+static KTest *readRawInput(const std::string &path) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return 0;
+
+  std::vector<unsigned char> bytes;
+  unsigned char buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof buffer, f)) != 0)
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  bool failed = ferror(f);
+  fclose(f);
+  if (failed)
+    return 0;
+
+  KTest *input = (KTest*) calloc(1, sizeof *input);
+  input->numObjects = 1;
+  input->objects = (KTestObject*) calloc(1, sizeof *input->objects);
+  KTestObject *o = &input->objects[0];
+  o->name = strdup("input");
+  o->numBytes = bytes.size();
+  o->bytes = (unsigned char*) malloc(o->numBytes ? o->numBytes : 1);
+  if (o->numBytes)
+    memcpy(o->bytes, &bytes[0], o->numBytes);
+  return input;
+}
+
+void Executor::syncCorpus(ExecutionState *initialState) {
+  DIR *dir = opendir(syncDirectory.c_str());
+  if (!dir) {
+    klee_warning_once(0, "unable to open sync directory %s: %s",
+                      syncDirectory.c_str(), strerror(errno));
+    return;
+  }
+
+  std::vector<std::string> paths;
+  while (struct dirent *instance = readdir(dir)) {
+    if (instance->d_name[0] == '.' || syncName == instance->d_name)
+      continue;
+    std::string queue = syncDirectory + "/" + instance->d_name + "/queue";
+    DIR *queueDir = opendir(queue.c_str());
+    if (!queueDir)
+      continue;
+    while (struct dirent *entry = readdir(queueDir)) {
+      if (entry->d_name[0] == '.')
+        continue;
+      std::string path = queue + "/" + entry->d_name;
+      if (!syncImported.count(path))
+        paths.push_back(path);
+    }
+    closedir(queueDir);
+  }
+  closedir(dir);
+
+  // Import in a fixed order, so that runs on the same corpus agree.
+  std::sort(paths.begin(), paths.end());
+  std::vector<KTest*> inputs;
+  for (unsigned i = 0, e = paths.size(); i != e; ++i) {
+    struct stat st;
+    if (stat(paths[i].c_str(), &st) < 0)
+      continue;
+    syncImported.insert(paths[i]);
+    if (!S_ISREG(st.st_mode))
+      continue;
+    if (KTest *input = readRawInput(paths[i]))
+      inputs.push_back(input);
+    else
+      klee_warning("unable to read %s, skipping", paths[i].c_str());
+  }
+  if (inputs.empty())
+    return;
+
+  // Before exploring nothing is covered yet, so following the inputs
+  // until they cover new code would not follow them at all: they are
+  // plain seeds instead.
+  ExecutionState *es = initialState;
+  if (!es) {
+    es = syncRoot->branch();
+    es->ptreeNode = processTree->attach(es);
+    addedStates.push_back(es);
+  }
+
+  std::vector<SeedInfo> &seeds = seedMap[es];
+  for (unsigned i = 0, e = inputs.size(); i != e; ++i) {
+    seeds.push_back(SeedInfo(inputs[i]));
+    seeds.back().external = true;
+    seeds.back().followOnly = !initialState;
+    syncInputs.push_back(inputs[i]);
+  }
+  numSeeds += inputs.size();
+
+  klee_message("imported %u inputs from %s", (unsigned) inputs.size(),
+               syncDirectory.c_str());
+}
+
+void Executor::releaseSyncedState(ExecutionState &state) {
+  if (!state.coveredNew || seedMap.empty())
+    return;
+
+  std::map< ExecutionState*, std::vector<SeedInfo> >::iterator it =
+    seedMap.find(&state);
+  if (it != seedMap.end() && !it->second.empty() &&
+      it->second[0].followOnly)
+    removeSeeds(&state);
+}
@@ -43,6 +43,16 @@ MaxTime("max-time",
         cl::desc("Halt execution after the specified number of seconds (0=off)"),
         cl::init(0));
 
+cl::opt<double>
+CheckpointInterval("checkpoint-interval",
+                   cl::desc("Write a checkpoint of the run every this many seconds, which --resume-from can continue from; SIGUSR1 then also requests one at any time (0=off)"),
+                   cl::init(0));
+
+cl::opt<double>
+SyncInterval("sync-interval",
+             cl::desc("Import new inputs from the --sync-dir queues of other instances every this many seconds (default=10)"),
+             cl::init(10));
+
 ///
 
 class HaltTimer : public Executor::Timer {
@@ -60,6 +70,34 @@ public:
 
 ///
 
+class CheckpointTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  CheckpointTimer(Executor *_executor) : executor(_executor) {}
+  ~CheckpointTimer() {}
+
+  void run() {
+    executor->writeCheckpoint();
+  }
+};
+
+///
+
+class SyncTimer : public Executor::Timer {
+  Executor *executor;
+
+public:
+  SyncTimer(Executor *_executor) : executor(_executor) {}
+  ~SyncTimer() {}
+
+  void run() {
+    executor->syncCorpus();
+  }
+};
+
+///
+
 static const double kSecondsPerTick = .1;
 static volatile unsigned timerTicks = 0;
 
@@ -71,6 +109,12 @@ static void onAlarm(int) {
   ++timerTicks;
 }
 
+static volatile sig_atomic_t checkpointRequested = 0;
+
+static void onCheckpointRequest(int) {
+  checkpointRequested = 1;
+}
+
 // oooogalay
 static void setupHandler() {
   struct itimerval t;
@@ -96,6 +140,16 @@ void Executor::initTimers() {
   if (MaxTime) {
     addTimer(new HaltTimer(this), MaxTime.getValue());
   }
+
+  if (CheckpointInterval) {
+    checkpointing = true;
+    ::signal(SIGUSR1, onCheckpointRequest);
+    addTimer(new CheckpointTimer(this), CheckpointInterval.getValue());
+  }
+
+  if (!syncDirectory.empty() && SyncInterval > 0) {
+    addTimer(new SyncTimer(this), SyncInterval.getValue());
+  }
 }
 
 ///
@@ -118,7 +172,12 @@ void Executor::processTimers(ExecutionState *current,
     ticks = 1;
   }
 
-  if (ticks || dumpPTree || dumpStates) {
+  if (ticks || dumpPTree || dumpStates || checkpointRequested) {
+    if (checkpointRequested) {
+      checkpointRequested = 0;
+      writeCheckpoint();
+    }
+
     if (dumpPTree) {
       char name[32];
       sprintf(name, "ptree%08d.dot", (int) stats::instructions);
@@ -180,7 +239,7 @@ void Executor::processTimers(ExecutionState *current,
       dumpStates = 0;
     }
 
-    if (maxInstTime>0 && current && !removedStates.count(current)) {
+    if (maxInstTime>0 && current && !isRemovedState(current)) {
       if (timerTicks*kSecondsPerTick > maxInstTime) {
         klee_warning("max-instruction-time exceeded: %.2fs",
                      timerTicks*kSecondsPerTick);
@@ -47,8 +47,14 @@
 #include "llvm/IR/CallSite.h"
 #endif
 
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <setjmp.h>
 #include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
@@ -126,11 +132,40 @@ ExternalDispatcher::~ExternalDispatcher() {
   delete executionEngine;
 }
 
-bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args) {
+/// Get the type through which the stub for the given call site calls
+/// its target: the declared parameter types, followed by the types of
+/// any variadic arguments.
+static LLVM_TYPE_Q FunctionType *getCallType(Function *target, Instruction *inst) {
+  CallSite cs;
+  if (inst->getOpcode()==Instruction::Call) {
+    cs = CallSite(cast<CallInst>(inst));
+  } else {
+    cs = CallSite(cast<InvokeInst>(inst));
+  }
+
+  LLVM_TYPE_Q FunctionType *FTy =
+    cast<FunctionType>(cast<PointerType>(target->getType())->getElementType());
+  std::vector<LLVM_TYPE_Q Type*> argTys;
+  unsigned i = 0;
+  for (CallSite::arg_iterator ai = cs.arg_begin(), ae = cs.arg_end();
+       ai!=ae; ++ai, ++i)
+    argTys.push_back(i < FTy->getNumParams() ? FTy->getParamType(i) : 
+                     (*ai)->getType());
+
+  return FunctionType::get(FTy->getReturnType(), argTys, false);
+}
+
+Function *ExternalDispatcher::getDispatcher(Function *f, Instruction *i) {
   dispatchers_ty::iterator it = dispatchers.find(i);
-  Function *dispatcher;
+  if (it != dispatchers.end())
+    return it->second;
 
-  if (it == dispatchers.end()) {
+  // Call sites passing the same argument types to the same function
+  // share a stub, so each external is usually only compiled once.
+  Function *dispatcher;
+  stubs_ty::key_type key(f, getCallType(f, i));
+  stubs_ty::iterator sit = stubs.find(key);
+  if (sit == stubs.end()) {
 #ifdef WINDOWS
     std::map<std::string, void*>::iterator it2 = 
       preboundFunctions.find(f->getName()));
@@ -146,7 +181,7 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
 
     dispatcher = createDispatcher(f,i);
 
-    dispatchers.insert(std::make_pair(i, dispatcher));
+    stubs.insert(std::make_pair(key, dispatcher));
 
     if (dispatcher) {
       // Force the JIT execution engine to go ahead and build the function. This
@@ -156,10 +191,118 @@ bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args
       executionEngine->recompileAndRelinkFunction(dispatcher);
     }
   } else {
-    dispatcher = it->second;
+    dispatcher = sit->second;
+  }
+
+  dispatchers.insert(std::make_pair(i, dispatcher));
+  return dispatcher;
+}
+
+bool ExternalDispatcher::executeCall(Function *f, Instruction *i, uint64_t *args) {
+  return runProtectedCall(getDispatcher(f, i), args);
+}
+
+static bool writeAll(int fd, const void *buf, size_t size) {
+  const char *p = (const char*) buf;
+  while (size) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool ExternalDispatcher::executeCallIsolated(Function *f, Instruction *i,
+                                             uint64_t *args,
+                                             const std::vector<MemoryRegion> &regions) {
+  // Build the stub here so the child does not have to, and so that JIT
+  // failures are not mistaken for a failing call.
+  Function *dispatcher = getDispatcher(f, i);
+  if (!dispatcher)
+    return false;
+
+  int fds[2];
+  if (pipe(fds) < 0)
+    return false;
+
+  // Anything still buffered would otherwise be written by both processes.
+  fflush(0);
+  llvm::outs().flush();
+
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+
+  if (pid == 0) {
+    // The reply is: the result words and errno, then (index, contents)
+    // for each region the call changed.
+    close(fds[0]);
+    bool ok = runProtectedCall(dispatcher, args);
+    int savedErrno = errno;
+    fflush(0);
+    if (!ok)
+      _exit(1);
+    if (!writeAll(fds[1], args, 2 * sizeof(*args)) ||
+        !writeAll(fds[1], &savedErrno, sizeof(savedErrno)))
+      _exit(1);
+    for (unsigned k = 0, e = regions.size(); k != e; ++k) {
+      const MemoryRegion &r = regions[k];
+      if (memcmp(r.address, r.original, r.size) != 0)
+        if (!writeAll(fds[1], &k, sizeof(k)) ||
+            !writeAll(fds[1], r.address, r.size))
+          _exit(1);
+    }
+    _exit(0);
+  }
+
+  close(fds[1]);
+  std::vector<char> reply;
+  char buf[4096];
+  for (;;) {
+    ssize_t n = read(fds[0], buf, sizeof(buf));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+    reply.insert(reply.end(), buf, buf + n);
+  }
+  close(fds[0]);
+
+  int status;
+  while (waitpid(pid, &status, 0) < 0)
+    if (errno != EINTR)
+      return false;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    return false;
+
+  size_t pos = 2 * sizeof(*args) + sizeof(int);
+  if (reply.size() < pos)
+    return false;
+  memcpy(args, &reply[0], 2 * sizeof(*args));
+  int childErrno;
+  memcpy(&childErrno, &reply[2 * sizeof(*args)], sizeof(childErrno));
+  while (pos != reply.size()) {
+    unsigned k;
+    if (reply.size() - pos < sizeof(k))
+      return false;
+    memcpy(&k, &reply[pos], sizeof(k));
+    pos += sizeof(k);
+    if (k >= regions.size() || reply.size() - pos < regions[k].size)
+      return false;
+    memcpy(regions[k].address, &reply[pos], regions[k].size);
+    pos += regions[k].size;
   }
+  errno = childErrno;
 
-  return runProtectedCall(dispatcher, args);
+  return true;
 }
 
 // FIXME: This is not reentrant.
@@ -12,6 +12,8 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <stddef.h>
 #include <stdint.h>
 
 namespace llvm {
@@ -27,14 +29,30 @@ namespace klee {
   private:
     typedef std::map<const llvm::Instruction*,llvm::Function*> dispatchers_ty;
     dispatchers_ty dispatchers;
+    typedef std::map<std::pair<const llvm::Function*,
+                               const llvm::FunctionType*>,
+                     llvm::Function*> stubs_ty;
+    stubs_ty stubs;
     llvm::Module *dispatchModule;
     llvm::ExecutionEngine *executionEngine;
     std::map<std::string, void*> preboundFunctions;
     
+    llvm::Function *getDispatcher(llvm::Function *f, llvm::Instruction *i);
     llvm::Function *createDispatcher(llvm::Function *f, llvm::Instruction *i);
     bool runProtectedCall(llvm::Function *f, uint64_t *args);
     
   public:
+    /// A range of native memory an isolated call may modify, along with
+    /// a copy of its contents before the call.
+    struct MemoryRegion {
+      void *address;
+      const void *original;
+      size_t size;
+
+      MemoryRegion(void *_address, const void *_original, size_t _size)
+        : address(_address), original(_original), size(_size) {}
+    };
+
     ExternalDispatcher();
     ~ExternalDispatcher();
 
@@ -43,6 +61,14 @@ namespace klee {
      * into args[0].
      */
     bool executeCall(llvm::Function *function, llvm::Instruction *i, uint64_t *args);
+
+    /// Like executeCall, but run the call in a forked child process so
+    /// that a crash or a stray write cannot damage this one. The changes
+    /// the call made to the given regions, its result and errno are
+    /// copied back; any other effect on the process state is lost.
+    bool executeCallIsolated(llvm::Function *function, llvm::Instruction *i,
+                             uint64_t *args,
+                             const std::vector<MemoryRegion> &regions);
     void *resolveSymbol(const std::string &name);
   };  
 }
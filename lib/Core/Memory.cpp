@@ -15,6 +15,9 @@
 #include "klee/Expr.h"
 #include "klee/Solver.h"
 #include "klee/util/BitArray.h"
+#include "klee/util/Bits.h"
+#include "klee/util/ExprRangeEvaluator.h"
+#include "klee/Internal/Support/IntEvaluation.h"
 
 #include "ObjectHolder.h"
 #include "MemoryManager.h"
@@ -32,6 +35,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
 #include <cassert>
 #include <sstream>
 
@@ -42,6 +46,11 @@ namespace {
   cl::opt<bool>
   UseConstantArrays("use-constant-arrays",
                     cl::init(true));
+
+  cl::opt<unsigned>
+  UpdateListCompactSize("update-list-compact-size",
+                        cl::desc("Compact the update list of an object when its length reaches a power of two at least this large (0=off, default=128)"),
+                        cl::init(128));
 }
 
 /***/
@@ -168,6 +177,8 @@ ObjectState::~ObjectState() {
 
   if (object)
   {
+    if (object->copiedOut == this)
+      object->copiedOut = 0;
     assert(object->refCount > 0);
     object->refCount--;
     if (object->refCount == 0)
@@ -179,6 +190,8 @@ ObjectState::~ObjectState() {
 
 /***/
 
+static unsigned numConstArrays = 0;
+
 const UpdateList &ObjectState::getUpdates() const {
   // Constant arrays are created lazily.
   if (!updates.root) {
@@ -216,15 +229,12 @@ const UpdateList &ObjectState::getUpdates() const {
       Contents[Index->getZExtValue()] = Value;
     }
 
-    // FIXME: We should unique these, there is no good reason to create multiple
-    // ones.
-
-    // Start a new update list.
-    // FIXME: Leaked.
-    static unsigned id = 0;
-    const Array *array = Array::CreateArray("const_arr" + llvm::utostr(++id), size,
-                                   &Contents[0],
-                                   &Contents[0] + Contents.size());
+    // Start a new update list, sharing the array of any earlier object
+    // with the same contents.
+    const Array *array =
+      Array::CreateUniqueConstantArray("const_arr" + llvm::utostr(++numConstArrays),
+                                       size, &Contents[0],
+                                       &Contents[0] + Contents.size());
     updates = UpdateList(array, 0);
 
     // Apply the remaining (non-constant) writes.
@@ -235,6 +245,69 @@ const UpdateList &ObjectState::getUpdates() const {
   return updates;
 }
 
+void ObjectState::compactUpdates(unsigned oldSize) const {
+  // Only look at the list each time it grows past a power of two, so
+  // the cost of the scan is amortized over the writes which grew it.
+  unsigned n = updates.getSize();
+  if (!UpdateListCompactSize || n < UpdateListCompactSize ||
+      (oldSize ^ n) <= oldSize)
+    return;
+
+  // Drop the writes shadowed by a newer write to the same concrete
+  // index; no read can ever see them. Newest first.
+  std::vector<const UpdateNode*> kept;
+  kept.reserve(n);
+  std::vector<bool> written(size);
+  for (const UpdateNode *un = updates.head; un; un = un->next) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(un->index)) {
+      uint64_t i = CE->getZExtValue();
+      if (i < size) {
+        if (written[i])
+          continue;
+        written[i] = true;
+      }
+    }
+    kept.push_back(un);
+  }
+
+  // The oldest fully concrete writes (those before any symbolic index
+  // could alias them) can be folded into a new snapshot of a constant
+  // root.
+  const Array *root = updates.root;
+  unsigned numFolded = 0;
+  if (root && root->isConstantArray()) {
+    for (; numFolded != kept.size(); ++numFolded) {
+      const UpdateNode *un = kept[kept.size() - 1 - numFolded];
+      ConstantExpr *index = dyn_cast<ConstantExpr>(un->index);
+      if (!index || index->getZExtValue() >= size ||
+          !isa<ConstantExpr>(un->value))
+        break;
+    }
+  }
+  // Not worth a new list unless it shrinks by a quarter; this also keeps
+  // a list hovering around a power of two from being rebuilt each time.
+  if (kept.size() - numFolded > n - n / 4)
+    return;
+
+  if (numFolded) {
+    std::vector< ref<ConstantExpr> > Contents(root->constantValues);
+    for (unsigned i = 0; i != numFolded; ++i) {
+      const UpdateNode *un = kept[kept.size() - 1 - i];
+      Contents[cast<ConstantExpr>(un->index)->getZExtValue()] =
+        cast<ConstantExpr>(un->value);
+    }
+    root =
+      Array::CreateUniqueConstantArray("const_arr" + llvm::utostr(++numConstArrays),
+                                       size, &Contents[0],
+                                       &Contents[0] + Contents.size());
+  }
+
+  UpdateList compacted(root, 0);
+  for (unsigned i = kept.size() - numFolded; i != 0; --i)
+    compacted.extend(kept[i - 1]->index, kept[i - 1]->value);
+  updates = compacted;
+}
+
 void ObjectState::makeConcrete() {
   if (concreteMask) delete concreteMask;
   if (flushMask) delete flushMask;
@@ -258,11 +331,13 @@ void ObjectState::makeSymbolic() {
 
 void ObjectState::initializeToZero() {
   makeConcrete();
+  touchConcreteStore();
   memset(concreteStore, 0, size);
 }
 
 void ObjectState::initializeToRandom() {  
   makeConcrete();
+  touchConcreteStore();
   for (unsigned i=0; i<size; i++) {
     // randomly selected by 256 sided die
     concreteStore[i] = 0xAB;
@@ -277,11 +352,156 @@ isByteConcrete(i) => !isByteKnownSymbolic(i)
 !isByteFlushed(i) => (isByteConcrete(i) || isByteKnownSymbolic(i))
  */
 
+namespace {
+  /// An unsigned interval of values, as evaluated over an expression by
+  /// ExprRangeEvaluator. Operations which may wrap around give the full
+  /// range of their width.
+  class ValueInterval {
+    uint64_t lo, hi;
+
+    static ValueInterval full(unsigned width) {
+      return ValueInterval(0, bits64::maxValueOfNBits(width));
+    }
+
+  public:
+    ValueInterval() : lo(1), hi(0) {}
+    ValueInterval(const ref<ConstantExpr> &ce)
+      : lo(ce->getLimitedValue()), hi(lo) {}
+    ValueInterval(uint64_t value) : lo(value), hi(value) {}
+    ValueInterval(uint64_t _lo, uint64_t _hi) : lo(_lo), hi(_hi) {}
+
+    bool isEmpty() const { return lo > hi; }
+    bool isFixed() const { return lo == hi; }
+    bool isFullRange(unsigned bits) const {
+      return lo == 0 && hi == bits64::maxValueOfNBits(bits);
+    }
+
+    bool mustEqual(uint64_t b) const { return lo == b && hi == b; }
+    bool mustEqual(const ValueInterval &b) const {
+      return isFixed() && b.isFixed() && lo == b.lo;
+    }
+    bool mayEqual(const ValueInterval &b) const {
+      return !isEmpty() && !b.isEmpty() && lo <= b.hi && b.lo <= hi;
+    }
+
+    ValueInterval set_union(const ValueInterval &b) const {
+      if (isEmpty())
+        return b;
+      if (b.isEmpty())
+        return *this;
+      return ValueInterval(std::min(lo, b.lo), std::max(hi, b.hi));
+    }
+
+    ValueInterval add(const ValueInterval &b, unsigned width) const {
+      uint64_t max = bits64::maxValueOfNBits(width);
+      if (hi > max - b.hi)
+        return full(width);
+      return ValueInterval(lo + b.lo, hi + b.hi);
+    }
+    ValueInterval sub(const ValueInterval &b, unsigned width) const {
+      if (lo < b.hi)
+        return full(width);
+      return ValueInterval(lo - b.hi, hi - b.lo);
+    }
+    ValueInterval mul(const ValueInterval &b, unsigned width) const {
+      uint64_t max = bits64::maxValueOfNBits(width);
+      if (hi && b.hi && hi > max / b.hi)
+        return full(width);
+      return ValueInterval(lo * b.lo, hi * b.hi);
+    }
+    ValueInterval udiv(const ValueInterval &b, unsigned width) const {
+      if (!b.lo)
+        return full(width);
+      return ValueInterval(lo / b.hi, hi / b.lo);
+    }
+    ValueInterval urem(const ValueInterval &b, unsigned width) const {
+      if (!b.lo)
+        return full(width);
+      return ValueInterval(hi < b.lo ? lo : 0, std::min(hi, b.hi - 1));
+    }
+    ValueInterval sdiv(const ValueInterval &b, unsigned width) const {
+      return full(width);
+    }
+    ValueInterval srem(const ValueInterval &b, unsigned width) const {
+      return full(width);
+    }
+
+    ValueInterval binaryAnd(const ValueInterval &b) const {
+      return ValueInterval(0, std::min(hi, b.hi));
+    }
+    ValueInterval binaryOr(const ValueInterval &b) const {
+      return ValueInterval(std::max(lo, b.lo), fill(std::max(hi, b.hi)));
+    }
+    ValueInterval binaryXor(const ValueInterval &b) const {
+      return ValueInterval(0, fill(std::max(hi, b.hi)));
+    }
+    /// All values below the highest bit of \a v, set or not.
+    static uint64_t fill(uint64_t v) {
+      for (unsigned shift = 1; shift < 64; shift <<= 1)
+        v |= v >> shift;
+      return v;
+    }
+
+    ValueInterval concat(const ValueInterval &b, unsigned bits) const {
+      if (bits >= 64)
+        return hi ? full(64) : b;
+      if (hi >> (64 - bits))
+        return full(64);
+      return ValueInterval((lo << bits) | b.lo, (hi << bits) | b.hi);
+    }
+    ValueInterval extract(uint64_t lowBit, uint64_t maxBit) const {
+      uint64_t mask = bits64::maxValueOfNBits(maxBit - lowBit);
+      uint64_t l = lo >> lowBit, h = hi >> lowBit;
+      // Truncation keeps the order only if no multiple of the new range
+      // lies in between.
+      if ((h & ~mask) != (l & ~mask))
+        return ValueInterval(0, mask);
+      return ValueInterval(l & mask, h & mask);
+    }
+
+    uint64_t min() const { return lo; }
+    uint64_t max() const { return hi; }
+    int64_t minSigned(unsigned bits) const {
+      uint64_t sign = (uint64_t) 1 << (bits - 1);
+      return hi >= sign ? ints::sext(sign, 64, bits) : (int64_t) lo;
+    }
+    int64_t maxSigned(unsigned bits) const {
+      uint64_t sign = (uint64_t) 1 << (bits - 1);
+      if (lo < sign && hi >= sign)
+        return sign - 1;
+      return ints::sext(hi, 64, bits);
+    }
+  };
+
+  class OffsetRangeEvaluator : public ExprRangeEvaluator<ValueInterval> {
+  protected:
+    ValueInterval getInitialReadRange(const Array &array,
+                                      ValueInterval index) {
+      if (array.isConstantArray() && index.isFixed() &&
+          index.min() < array.size)
+        return ValueInterval(array.constantValues[index.min()]);
+      return ValueInterval(0, 255);
+    }
+  };
+}
+
 void ObjectState::fastRangeCheckOffset(ref<Expr> offset,
                                        unsigned *base_r,
                                        unsigned *size_r) const {
-  *base_r = 0;
-  *size_r = size;
+  // Only the bytes a symbolic offset can actually reach need to be
+  // flushed to the update list; everything else stays in the cache.
+  ValueInterval range =
+    OffsetRangeEvaluator().evaluate(ZExtExpr::create(offset, Expr::Int32));
+  uint64_t min = range.min(), max = range.max();
+  if (min >= size) {
+    *base_r = 0;
+    *size_r = size;
+    return;
+  }
+  if (max >= size)
+    max = size - 1;
+  *base_r = min;
+  *size_r = max - min + 1;
 }
 
 void ObjectState::flushRangeForRead(unsigned rangeBase, 
@@ -399,9 +619,10 @@ ref<Expr> ObjectState::read8(unsigned offset) const {
 
 ref<Expr> ObjectState::read8(ref<Expr> offset) const {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic read8");
-  unsigned base, size;
+  unsigned base, size, numUpdates = updates.getSize();
   fastRangeCheckOffset(offset, &base, &size);
   flushRangeForRead(base, size);
+  compactUpdates(numUpdates);
 
   if (size>4096) {
     std::string allocInfo;
@@ -416,6 +637,7 @@ ref<Expr> ObjectState::read8(ref<Expr> offset) const {
 
 void ObjectState::write8(unsigned offset, uint8_t value) {
   //assert(read_only == false && "writing to read-only object!");
+  touchConcreteStore();
   concreteStore[offset] = value;
   setKnownSymbolic(offset, 0);
 
@@ -437,7 +659,7 @@ void ObjectState::write8(unsigned offset, ref<Expr> value) {
 
 void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
   assert(!isa<ConstantExpr>(offset) && "constant offset passed to symbolic write8");
-  unsigned base, size;
+  unsigned base, size, numUpdates = updates.getSize();
   fastRangeCheckOffset(offset, &base, &size);
   flushRangeForWrite(base, size);
 
@@ -450,6 +672,7 @@ void ObjectState::write8(ref<Expr> offset, ref<Expr> value) {
   }
   
   updates.extend(ZExtExpr::create(offset, Expr::Int32), value);
+  compactUpdates(numUpdates);
 }
 
 /***/
@@ -26,17 +26,24 @@ namespace klee {
 
 class BitArray;
 class MemoryManager;
+class ObjectState;
 class Solver;
 
 class MemoryObject {
   friend class STPBuilder;
   friend class ObjectState;
   friend class ExecutionState;
+  friend class AddressSpace;
 
 private:
   static int counter;
   mutable unsigned refCount;
 
+  /// The object state whose concrete contents the native memory at
+  /// address was last made to match, or null if unknown. Cleared
+  /// whenever that object state's concrete store is written.
+  mutable const ObjectState *copiedOut;
+
 public:
   unsigned id;
   uint64_t address;
@@ -75,6 +82,7 @@ public:
   explicit
   MemoryObject(uint64_t _address) 
     : refCount(0),
+      copiedOut(0),
       id(counter++), 
       address(_address),
       size(0),
@@ -88,6 +96,7 @@ public:
                const llvm::Value *_allocSite,
                MemoryManager *_parent)
     : refCount(0), 
+      copiedOut(0),
       id(counter++),
       address(_address),
       size(_size),
@@ -153,6 +162,8 @@ private:
   friend class ObjectHolder;
   unsigned refCount;
 
+  friend class StateOffloader;
+
   const MemoryObject *object;
 
   uint8_t *concreteStore;
@@ -210,6 +221,18 @@ public:
 private:
   const UpdateList &getUpdates() const;
 
+  /// Shorten a long update list, which was oldSize entries long before
+  /// the last access: drop shadowed writes and fold the oldest concrete
+  /// ones into the root array.
+  void compactUpdates(unsigned oldSize) const;
+
+  /// Note that the concrete store is about to change, so it may no
+  /// longer match the native memory of the object.
+  void touchConcreteStore() {
+    if (object && object->copiedOut == this)
+      object->copiedOut = 0;
+  }
+
   void makeConcrete();
 
   void makeSymbolic();
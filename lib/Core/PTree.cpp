@@ -9,50 +9,102 @@
 
 #include "PTree.h"
 
-#include <klee/Expr.h>
-#include <klee/util/ExprPPrinter.h>
+#include "llvm/Support/raw_ostream.h"
 
+#include <cassert>
 #include <vector>
 
 using namespace klee;
 
   /* *** */
 
-PTree::PTree(const data_type &_root) : root(new Node(0,_root)) {
+const PTree::NodeId PTree::None;
+
+PTree::PTree(const data_type &_root) {
+  // Node 0 is never handed out so that it can serve as the null link.
+  PTreeNode sentinel = { None, { None, None }, 0 };
+  nodes.push_back(sentinel);
+  root = allocate(None, _root);
 }
 
 PTree::~PTree() {}
 
-std::pair<PTreeNode*, PTreeNode*>
-PTree::split(Node *n, 
+PTree::NodeId PTree::allocate(NodeId parent, const data_type &data) {
+  PTreeNode node = { parent, { None, None }, data };
+  if (!freeNodes.empty()) {
+    NodeId n = freeNodes.back();
+    freeNodes.pop_back();
+    nodes[n] = node;
+    return n;
+  }
+  nodes.push_back(node);
+  return nodes.size() - 1;
+}
+
+void PTree::release(NodeId n) {
+  nodes[n].data = 0;
+  freeNodes.push_back(n);
+}
+
+std::pair<PTree::NodeId, PTree::NodeId>
+PTree::split(NodeId n, 
              const data_type &leftData, 
              const data_type &rightData) {
-  assert(n && !n->left && !n->right);
-  n->left = new Node(n, leftData);
-  n->right = new Node(n, rightData);
-  return std::make_pair(n->left, n->right);
+  assert(n != None && nodes[n].isLeaf());
+  // Allocate first, the arena may grow and move the nodes.
+  NodeId left = allocate(n, leftData);
+  NodeId right = allocate(n, rightData);
+  PTreeNode &node = nodes[n];
+  node.data = 0;
+  node.children[0] = left;
+  node.children[1] = right;
+  return std::make_pair(left, right);
 }
 
-void PTree::remove(Node *n) {
-  assert(!n->left && !n->right);
-  do {
-    Node *p = n->parent;
-    delete n;
-    if (p) {
-      if (n == p->left) {
-        p->left = 0;
-      } else {
-        assert(n == p->right);
-        p->right = 0;
-      }
-    }
-    n = p;
-  } while (n && !n->left && !n->right);
+PTree::NodeId PTree::attach(const data_type &data) {
+  NodeId leaf = allocate(None, data);
+  if (root == None) {
+    root = leaf;
+    return leaf;
+  }
+  NodeId top = allocate(None, 0);
+  PTreeNode &node = nodes[top];
+  node.children[0] = root;
+  node.children[1] = leaf;
+  nodes[root].parent = top;
+  nodes[leaf].parent = top;
+  root = top;
+  return leaf;
+}
+
+void PTree::remove(NodeId n) {
+  assert(n != None && nodes[n].isLeaf());
+  NodeId p = nodes[n].parent;
+  release(n);
+
+  if (p == None) {
+    root = None;
+    return;
+  }
+
+  // The parent is left with a single child, splice it out.
+  PTreeNode &parent = nodes[p];
+  NodeId sibling = parent.children[0] == n ? parent.children[1] 
+                                           : parent.children[0];
+  assert((parent.children[0] == n || parent.children[1] == n) &&
+         "invalid process tree");
+  NodeId grandparent = parent.parent;
+  nodes[sibling].parent = grandparent;
+  if (grandparent == None) {
+    root = sibling;
+  } else {
+    PTreeNode &gp = nodes[grandparent];
+    gp.children[gp.children[0] == p ? 0 : 1] = sibling;
+  }
+  release(p);
 }
 
 void PTree::dump(llvm::raw_ostream &os) {
-  ExprPPrinter *pp = ExprPPrinter::create(os);
-  pp->setNewline("\\l");
   os << "digraph G {\n";
   os << "\tsize=\"10,7.5\";\n";
   os << "\tratio=fill;\n";
@@ -60,43 +112,23 @@ void PTree::dump(llvm::raw_ostream &os) {
   os << "\tcenter = \"true\";\n";
   os << "\tnode [style=\"filled\",width=.1,height=.1,fontname=\"Terminus\"]\n";
   os << "\tedge [arrowsize=.3]\n";
-  std::vector<PTree::Node*> stack;
-  stack.push_back(root);
+  std::vector<NodeId> stack;
+  if (root != None)
+    stack.push_back(root);
   while (!stack.empty()) {
-    PTree::Node *n = stack.back();
+    NodeId id = stack.back();
+    const PTreeNode &n = nodes[id];
     stack.pop_back();
-    if (n->condition.isNull()) {
-      os << "\tn" << n << " [label=\"\"";
-    } else {
-      os << "\tn" << n << " [label=\"";
-      pp->print(n->condition);
-      os << "\",shape=diamond";
-    }
-    if (n->data)
+    os << "\tn" << id << " [label=\"\"";
+    if (n.data)
       os << ",fillcolor=green";
     os << "];\n";
-    if (n->left) {
-      os << "\tn" << n << " -> n" << n->left << ";\n";
-      stack.push_back(n->left);
-    }
-    if (n->right) {
-      os << "\tn" << n << " -> n" << n->right << ";\n";
-      stack.push_back(n->right);
+    for (unsigned i = 0; i != 2; ++i) {
+      if (n.children[i] != None) {
+        os << "\tn" << id << " -> n" << n.children[i] << ";\n";
+        stack.push_back(n.children[i]);
+      }
     }
   }
   os << "}\n";
-  delete pp;
 }
-
-PTreeNode::PTreeNode(PTreeNode *_parent, 
-                     ExecutionState *_data) 
-  : parent(_parent),
-    left(0),
-    right(0),
-    data(_data),
-    condition(0) {
-}
-
-PTreeNode::~PTreeNode() {
-}
-
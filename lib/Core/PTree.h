@@ -10,39 +10,74 @@
 #ifndef __UTIL_PTREE_H__
 #define __UTIL_PTREE_H__
 
-#include <klee/Expr.h>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+  class raw_ostream;
+}
 
 namespace klee {
   class ExecutionState;
 
+  /// A node of the process tree. Nodes are stored in the arena owned by
+  /// the PTree and refer to each other by index; \ref PTree::None marks
+  /// a missing link.
+  struct PTreeNode {
+    unsigned parent;
+    /// The left (0) and right (1) children; either both are set or the
+    /// node is a leaf.
+    unsigned children[2];
+    /// The state at a leaf, null for interior nodes.
+    ExecutionState *data;
+
+    bool isLeaf() const { return data != 0; }
+  };
+
+  /// The process tree records the fork history of all live states. Its
+  /// leaves are exactly the live states: when a state is removed its leaf
+  /// and the now single-child parent are reclaimed together, splicing the
+  /// sibling into the grandparent, so every interior node always has two
+  /// children and random-path selection never walks through dead chains.
+  ///
+  /// Nodes keep no subtree-size or leaf counters. Random-path selection
+  /// picks a leaf with probability 2^-depth, which is defined by the path
+  /// itself, so counters could not replace the walk from the root; and
+  /// keeping them would turn split() and remove() from O(1) into O(depth)
+  /// updates of every ancestor.
   class PTree { 
     typedef ExecutionState* data_type;
 
   public:
-    typedef class PTreeNode Node;
-    Node *root;
+    typedef unsigned NodeId;
+    static const NodeId None = 0;
+
+  private:
+    std::vector<PTreeNode> nodes;
+    std::vector<NodeId> freeNodes;
+
+    NodeId allocate(NodeId parent, const data_type &data);
+    void release(NodeId n);
+
+  public:
+    NodeId root;
 
     PTree(const data_type &_root);
     ~PTree();
-    
-    std::pair<Node*,Node*> split(Node *n,
-                                 const data_type &leftData,
-                                 const data_type &rightData);
-    void remove(Node *n);
 
-    void dump(llvm::raw_ostream &os);
-  };
+    const PTreeNode &getNode(NodeId n) const { return nodes[n]; }
 
-  class PTreeNode {
-    friend class PTree;
-  public:
-    PTreeNode *parent, *left, *right;
-    ExecutionState *data;
-    ref<Expr> condition;
+    /// Turn the leaf \a n into an interior node with two fresh leaves
+    /// holding \a leftData and \a rightData.
+    std::pair<NodeId,NodeId> split(NodeId n,
+                                   const data_type &leftData,
+                                   const data_type &rightData);
+    /// Add a leaf holding \a data, a state not forked from any live one,
+    /// as the sibling of the current root under a new root.
+    NodeId attach(const data_type &data);
+    void remove(NodeId n);
 
-  private:
-    PTreeNode(PTreeNode *_parent, ExecutionState *_data);
-    ~PTreeNode();
+    void dump(llvm::raw_ostream &os);
   };
 }
 
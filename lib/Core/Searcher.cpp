@@ -13,6 +13,7 @@
 
 #include "CoreStats.h"
 #include "Executor.h"
+#include "Memory.h"
 #include "PTree.h"
 #include "StatsTracker.h"
 
@@ -34,6 +35,7 @@
 #include "llvm/Instructions.h"
 #include "llvm/Module.h"
 #endif
+#include "llvm/Analysis/PostDominators.h"
 #include "llvm/Support/CommandLine.h"
 
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
@@ -42,7 +44,9 @@
 #include "llvm/IR/CallSite.h"
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <fstream>
 #include <climits>
 
@@ -58,41 +62,60 @@ namespace klee {
   extern RNG theRNG;
 }
 
+static unsigned nextHandleSlot = 0;
+
+Searcher::Searcher() : handleSlot(nextHandleSlot++) {
+}
+
 Searcher::~Searcher() {
 }
 
+unsigned &Searcher::getHandle(ExecutionState *es) {
+  if (es->searcherHandles.size() <= handleSlot)
+    es->searcherHandles.resize(handleSlot + 1);
+  return es->searcherHandles[handleSlot];
+}
+
 ///
 
 ExecutionState &DFSSearcher::selectState() {
   return *states.back();
 }
 
+void DFSSearcher::compact() {
+  unsigned j = 0;
+  for (unsigned i = 0, e = states.size(); i != e; ++i) {
+    if (ExecutionState *es = states[i]) {
+      getHandle(es) = j;
+      states[j++] = es;
+    }
+  }
+  states.resize(j);
+  numRemoved = 0;
+}
+
 void DFSSearcher::update(ExecutionState *current,
-                         const std::set<ExecutionState*> &addedStates,
-                         const std::set<ExecutionState*> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
-  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+                         const StateList &addedStates,
+                         const StateList &removedStates) {
+  for (StateList::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it) {
+    getHandle(*it) = states.size();
+    states.push_back(*it);
+  }
+  for (StateList::const_iterator it = removedStates.begin(),
          ie = removedStates.end(); it != ie; ++it) {
-    ExecutionState *es = *it;
-    if (es == states.back()) {
-      states.pop_back();
-    } else {
-      bool ok = false;
-
-      for (std::vector<ExecutionState*>::iterator it = states.begin(),
-             ie = states.end(); it != ie; ++it) {
-        if (es==*it) {
-          states.erase(it);
-          ok = true;
-          break;
-        }
-      }
-
-      assert(ok && "invalid state removed");
-    }
+    unsigned handle = getHandle(*it);
+    assert(handle < states.size() && states[handle] == *it &&
+           "invalid state removed");
+    states[handle] = 0;
+    ++numRemoved;
+  }
+  while (!states.empty() && !states.back()) {
+    states.pop_back();
+    --numRemoved;
   }
+  if (numRemoved > 64 && numRemoved > states.size() / 2)
+    compact();
 }
 
 ///
@@ -101,32 +124,42 @@ ExecutionState &BFSSearcher::selectState() {
   return *states.front();
 }
 
+void BFSSearcher::compact() {
+  unsigned j = 0;
+  for (unsigned i = 0, e = states.size(); i != e; ++i) {
+    if (ExecutionState *es = states[i]) {
+      getHandle(es) = j;
+      states[j++] = es;
+    }
+  }
+  states.resize(j);
+  popped = 0;
+  numRemoved = 0;
+}
+
 void BFSSearcher::update(ExecutionState *current,
-                         const std::set<ExecutionState*> &addedStates,
-                         const std::set<ExecutionState*> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
-  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+                         const StateList &addedStates,
+                         const StateList &removedStates) {
+  for (StateList::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it) {
+    getHandle(*it) = popped + states.size();
+    states.push_back(*it);
+  }
+  for (StateList::const_iterator it = removedStates.begin(),
          ie = removedStates.end(); it != ie; ++it) {
-    ExecutionState *es = *it;
-    if (es == states.front()) {
-      states.pop_front();
-    } else {
-      bool ok = false;
-
-      for (std::deque<ExecutionState*>::iterator it = states.begin(),
-             ie = states.end(); it != ie; ++it) {
-        if (es==*it) {
-          states.erase(it);
-          ok = true;
-          break;
-        }
-      }
-
-      assert(ok && "invalid state removed");
-    }
+    unsigned index = getHandle(*it) - popped;
+    assert(index < states.size() && states[index] == *it &&
+           "invalid state removed");
+    states[index] = 0;
+    ++numRemoved;
+  }
+  while (!states.empty() && !states.front()) {
+    states.pop_front();
+    ++popped;
+    --numRemoved;
   }
+  if (numRemoved > 64 && numRemoved > states.size() / 2)
+    compact();
 }
 
 ///
@@ -136,26 +169,24 @@ ExecutionState &RandomSearcher::selectState() {
 }
 
 void RandomSearcher::update(ExecutionState *current,
-                            const std::set<ExecutionState*> &addedStates,
-                            const std::set<ExecutionState*> &removedStates) {
-  states.insert(states.end(),
-                addedStates.begin(),
-                addedStates.end());
-  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+                            const StateList &addedStates,
+                            const StateList &removedStates) {
+  for (StateList::const_iterator it = addedStates.begin(),
+         ie = addedStates.end(); it != ie; ++it) {
+    getHandle(*it) = states.size();
+    states.push_back(*it);
+  }
+  for (StateList::const_iterator it = removedStates.begin(),
          ie = removedStates.end(); it != ie; ++it) {
-    ExecutionState *es = *it;
-    bool ok = false;
-
-    for (std::vector<ExecutionState*>::iterator it = states.begin(),
-           ie = states.end(); it != ie; ++it) {
-      if (es==*it) {
-        states.erase(it);
-        ok = true;
-        break;
-      }
-    }
-    
-    assert(ok && "invalid state removed");
+    // The order of the states is irrelevant, so move the last state
+    // into the hole.
+    unsigned handle = getHandle(*it);
+    assert(handle < states.size() && states[handle] == *it &&
+           "invalid state removed");
+    ExecutionState *last = states.back();
+    states[handle] = last;
+    getHandle(last) = handle;
+    states.pop_back();
   }
 }
 
@@ -173,6 +204,7 @@ WeightedRandomSearcher::WeightedRandomSearcher(WeightType _type)
   case QueryCost:
   case MinDistToUncovered:
   case CoveringNew:
+  case CoveragePerCost:
     updateWeights = true;
     break;
   default:
@@ -188,6 +220,20 @@ ExecutionState &WeightedRandomSearcher::selectState() {
   return *states->choose(theRNG.getDoubleL());
 }
 
+/// Predict the time (in seconds) the next step of the state will spend
+/// in the solver, from its recent query latencies and the size of the
+/// problem it is building up.
+static double predictStepCost(ExecutionState *es) {
+  uint64_t symbolicBytes = 0;
+  for (unsigned i = 0, e = es->symbolics.size(); i != e; ++i)
+    symbolicBytes += es->symbolics[i].first->size;
+
+  // The constant term keeps states which have not queried the solver
+  // yet from being infinitely preferred.
+  return 1e-3 + es->recentQueryCost +
+    1e-5 * es->constraints.size() + 1e-7 * symbolicBytes;
+}
+
 double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   switch(type) {
   default:
@@ -208,16 +254,20 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
   case QueryCost:
     return (es->queryCost < .1) ? 1. : 1./es->queryCost;
   case CoveringNew:
+  case CoveragePerCost:
   case MinDistToUncovered: {
     uint64_t md2u = computeMinDistToUncovered(es->pc,
                                               es->stack.back().minDistToUncoveredOnReturn);
 
     double invMD2U = 1. / (md2u ? md2u : 10000);
-    if (type==CoveringNew) {
+    if (type==CoveringNew || type==CoveragePerCost) {
       double invCovNew = 0.;
       if (es->instsSinceCovNew)
         invCovNew = 1. / std::max(1, (int) es->instsSinceCovNew - 1000);
-      return (invCovNew * invCovNew + invMD2U * invMD2U);
+      double potential = invCovNew * invCovNew + invMD2U * invMD2U;
+      if (type==CoveragePerCost)
+        return potential / predictStepCost(es);
+      return potential;
     } else {
       return invMD2U * invMD2U;
     }
@@ -226,18 +276,20 @@ double WeightedRandomSearcher::getWeight(ExecutionState *es) {
 }
 
 void WeightedRandomSearcher::update(ExecutionState *current,
-                                    const std::set<ExecutionState*> &addedStates,
-                                    const std::set<ExecutionState*> &removedStates) {
-  if (current && updateWeights && !removedStates.count(current))
+                                    const StateList &addedStates,
+                                    const StateList &removedStates) {
+  if (current && updateWeights &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+        removedStates.end())
     states->update(current, getWeight(current));
   
-  for (std::set<ExecutionState*>::const_iterator it = addedStates.begin(),
+  for (StateList::const_iterator it = addedStates.begin(),
          ie = addedStates.end(); it != ie; ++it) {
     ExecutionState *es = *it;
     states->insert(es, getWeight(es));
   }
 
-  for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+  for (StateList::const_iterator it = removedStates.begin(),
          ie = removedStates.end(); it != ie; ++it) {
     states->remove(*it);
   }
@@ -257,30 +309,28 @@ RandomPathSearcher::~RandomPathSearcher() {
 }
 
 ExecutionState &RandomPathSearcher::selectState() {
+  const PTree &tree = *executor.processTree;
   unsigned flips=0, bits=0;
-  PTree::Node *n = executor.processTree->root;
+  PTree::NodeId n = tree.root;
   
-  while (!n->data) {
-    if (!n->left) {
-      n = n->right;
-    } else if (!n->right) {
-      n = n->left;
-    } else {
-      if (bits==0) {
-        flips = theRNG.getInt32();
-        bits = 32;
-      }
-      --bits;
-      n = (flips&(1<<bits)) ? n->left : n->right;
+  // Every interior node of the process tree has two children, so each
+  // step consumes exactly one random bit. The walk is what defines the
+  // distribution (see PTree), so it is not shortcut.
+  while (!tree.getNode(n).isLeaf()) {
+    if (bits==0) {
+      flips = theRNG.getInt32();
+      bits = 32;
     }
+    --bits;
+    n = tree.getNode(n).children[(flips >> bits) & 1];
   }
 
-  return *n->data;
+  return *tree.getNode(n).data;
 }
 
 void RandomPathSearcher::update(ExecutionState *current,
-                                const std::set<ExecutionState*> &addedStates,
-                                const std::set<ExecutionState*> &removedStates) {
+                                const StateList &addedStates,
+                                const StateList &removedStates) {
 }
 
 bool RandomPathSearcher::empty() { 
@@ -340,6 +390,8 @@ entry:
       statesAtMerge.insert(std::make_pair(mp, &es));
     } else {
       ExecutionState *mergeWith = it->second;
+      executor.ensureResident(*mergeWith);
+      executor.ensureResident(es);
       if (mergeWith->merge(es)) {
         // hack, because we are terminating the state we need to let
         // the baseSearcher know about it again
@@ -360,13 +412,140 @@ entry:
 }
 
 void BumpMergingSearcher::update(ExecutionState *current,
-                                 const std::set<ExecutionState*> &addedStates,
-                                 const std::set<ExecutionState*> &removedStates) {
+                                 const StateList &addedStates,
+                                 const StateList &removedStates) {
   baseSearcher->update(current, addedStates, removedStates);
 }
 
 ///
 
+AutoMergingSearcher::AutoMergingSearcher(Executor &_executor,
+                                         Searcher *_baseSearcher,
+                                         unsigned _maxSelects)
+  : executor(_executor),
+    baseSearcher(_baseSearcher),
+    maxSelects(_maxSelects) {
+}
+
+AutoMergingSearcher::~AutoMergingSearcher() {
+  delete baseSearcher;
+}
+
+///
+
+const std::set<BasicBlock*> &
+AutoMergingSearcher::getJoinBlocks(Function *f) {
+  std::map<Function*, std::set<BasicBlock*> >::iterator it =
+    joinBlocks.find(f);
+  if (it != joinBlocks.end())
+    return it->second;
+
+  std::set<BasicBlock*> &joins = joinBlocks[f];
+  PostDominatorTree pdt;
+  pdt.runOnFunction(*f);
+  for (Function::iterator bbit = f->begin(), bbie = f->end();
+       bbit != bbie; ++bbit) {
+    if (bbit->getTerminator()->getNumSuccessors() < 2)
+      continue;
+    DomTreeNode *node = pdt.getNode(bbit);
+    if (node && node->getIDom() && node->getIDom()->getBlock())
+      joins.insert(node->getIDom()->getBlock());
+  }
+  return joins;
+}
+
+KInstruction *AutoMergingSearcher::getMergePoint(ExecutionState &es) {
+  // States are merged past any phi nodes, since which incoming value
+  // those take depends on the path.
+  KInstruction *ki = es.pc;
+  BasicBlock *bb = ki->inst->getParent();
+  if (ki->inst != bb->getFirstNonPHI() ||
+      !getJoinBlocks(bb->getParent()).count(bb))
+    return 0;
+
+  std::map<ExecutionState*, uint64_t>::iterator it = released.find(&es);
+  if (it != released.end() && it->second == es.steppedInstructions)
+    return 0;
+
+  return ki;
+}
+
+void AutoMergingSearcher::release(ExecutionState *es) {
+  released[es] = es->steppedInstructions;
+  baseSearcher->addState(es);
+}
+
+ExecutionState &AutoMergingSearcher::selectState() {
+entry:
+  // out of base states, let a waiting one go
+  if (baseSearcher->empty()) {
+    std::map<KInstruction*, ExecutionState*>::iterator it = 
+      statesAtMerge.begin();
+    ExecutionState *es = it->second;
+    statesAtMerge.erase(it);
+    release(es);
+  }
+
+  ExecutionState &es = baseSearcher->selectState();
+
+  if (KInstruction *mp = getMergePoint(es)) {
+    std::map<KInstruction*, ExecutionState*>::iterator it = 
+      statesAtMerge.find(mp);
+
+    baseSearcher->removeState(&es);
+
+    if (it==statesAtMerge.end()) {
+      statesAtMerge.insert(std::make_pair(mp, &es));
+    } else {
+      ExecutionState *mergeWith = it->second;
+      executor.ensureResident(*mergeWith);
+      executor.ensureResident(es);
+      if (mergeWith->merge(es, maxSelects)) {
+        if (DebugLogMerge)
+          llvm::errs() << "\t\tmerged: " << mergeWith << " with " << &es
+                       << "\n";
+        // hack, because we are terminating the state we need to let
+        // the baseSearcher know about it again
+        baseSearcher->addState(&es);
+        executor.terminateState(es);
+      } else {
+        it->second = &es;
+        release(mergeWith);
+      }
+    }
+
+    goto entry;
+  } else {
+    return es;
+  }
+}
+
+void AutoMergingSearcher::update(ExecutionState *current,
+                                 const StateList &addedStates,
+                                 const StateList &removedStates) {
+  if (!removedStates.empty()) {
+    // Waiting states can still be killed, e.g. at the memory cap.
+    llvm::SmallVector<ExecutionState*, 8> alt;
+    for (StateList::const_iterator it = removedStates.begin(),
+           ie = removedStates.end(); it != ie; ++it) {
+      ExecutionState *es = *it;
+      released.erase(es);
+      std::map<KInstruction*, ExecutionState*>::iterator it2 =
+        statesAtMerge.find(es->pc);
+      if (it2 != statesAtMerge.end() && it2->second == es) {
+        statesAtMerge.erase(it2);
+      } else {
+        alt.push_back(es);
+      }
+    }
+    baseSearcher->update(current, addedStates, alt);
+  } else {
+    baseSearcher->update(current, addedStates, removedStates);
+  }
+}
+
+///
+
 MergingSearcher::MergingSearcher(Executor &_executor, Searcher *_baseSearcher) 
   : executor(_executor),
     baseSearcher(_baseSearcher),
@@ -433,12 +612,14 @@ ExecutionState &MergingSearcher::selectState() {
     while (!toMerge.empty()) {
       ExecutionState *base = *toMerge.begin();
       toMerge.erase(toMerge.begin());
+      executor.ensureResident(*base);
       
       std::set<ExecutionState*> toErase;
       for (std::set<ExecutionState*>::iterator it = toMerge.begin(),
              ie = toMerge.end(); it != ie; ++it) {
         ExecutionState *mergeWith = *it;
-        
+        executor.ensureResident(*mergeWith);
+
         if (base->merge(*mergeWith)) {
           toErase.insert(mergeWith);
         }
@@ -474,17 +655,18 @@ ExecutionState &MergingSearcher::selectState() {
 }
 
 void MergingSearcher::update(ExecutionState *current,
-                             const std::set<ExecutionState*> &addedStates,
-                             const std::set<ExecutionState*> &removedStates) {
+                             const StateList &addedStates,
+                             const StateList &removedStates) {
   if (!removedStates.empty()) {
-    std::set<ExecutionState *> alt = removedStates;
-    for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+    llvm::SmallVector<ExecutionState*, 8> alt;
+    for (StateList::const_iterator it = removedStates.begin(),
            ie = removedStates.end(); it != ie; ++it) {
       ExecutionState *es = *it;
-      std::set<ExecutionState*>::const_iterator it2 = statesAtMerge.find(es);
+      std::set<ExecutionState*>::iterator it2 = statesAtMerge.find(es);
       if (it2 != statesAtMerge.end()) {
         statesAtMerge.erase(it2);
-        alt.erase(alt.find(es));
+      } else {
+        alt.push_back(es);
       }
     }    
     baseSearcher->update(current, addedStates, alt);
@@ -531,9 +713,10 @@ ExecutionState &BatchingSearcher::selectState() {
 }
 
 void BatchingSearcher::update(ExecutionState *current,
-                              const std::set<ExecutionState*> &addedStates,
-                              const std::set<ExecutionState*> &removedStates) {
-  if (removedStates.count(lastState))
+                              const StateList &addedStates,
+                              const StateList &removedStates) {
+  if (std::find(removedStates.begin(), removedStates.end(), lastState) !=
+        removedStates.end())
     lastState = 0;
   baseSearcher->update(current, addedStates, removedStates);
 }
@@ -556,19 +739,20 @@ ExecutionState &IterativeDeepeningTimeSearcher::selectState() {
 }
 
 void IterativeDeepeningTimeSearcher::update(ExecutionState *current,
-                                            const std::set<ExecutionState*> &addedStates,
-                                            const std::set<ExecutionState*> &removedStates) {
+                                            const StateList &addedStates,
+                                            const StateList &removedStates) {
   double elapsed = util::getWallTime() - startTime;
 
   if (!removedStates.empty()) {
-    std::set<ExecutionState *> alt = removedStates;
-    for (std::set<ExecutionState*>::const_iterator it = removedStates.begin(),
+    llvm::SmallVector<ExecutionState*, 8> alt;
+    for (StateList::const_iterator it = removedStates.begin(),
            ie = removedStates.end(); it != ie; ++it) {
       ExecutionState *es = *it;
-      std::set<ExecutionState*>::const_iterator it2 = pausedStates.find(es);
+      std::set<ExecutionState*>::iterator it2 = pausedStates.find(es);
       if (it2 != pausedStates.end()) {
-        pausedStates.erase(it);
-        alt.erase(alt.find(es));
+        pausedStates.erase(it2);
+      } else {
+        alt.push_back(es);
       }
     }    
     baseSearcher->update(current, addedStates, alt);
@@ -576,7 +760,9 @@ void IterativeDeepeningTimeSearcher::update(ExecutionState *current,
     baseSearcher->update(current, addedStates, removedStates);
   }
 
-  if (current && !removedStates.count(current) && elapsed>time) {
+  if (current && elapsed>time &&
+      std::find(removedStates.begin(), removedStates.end(), current) ==
+        removedStates.end()) {
     pausedStates.insert(current);
     baseSearcher->removeState(current);
   }
@@ -584,7 +770,9 @@ void IterativeDeepeningTimeSearcher::update(ExecutionState *current,
   if (baseSearcher->empty()) {
     time *= 2;
     llvm::errs() << "KLEE: increasing time budget to: " << time << "\n";
-    baseSearcher->update(0, pausedStates, std::set<ExecutionState*>());
+    llvm::SmallVector<ExecutionState*, 8> paused(pausedStates.begin(),
+                                                 pausedStates.end()), none;
+    baseSearcher->update(0, paused, none);
     pausedStates.clear();
   }
 }
@@ -609,8 +797,88 @@ ExecutionState &InterleavedSearcher::selectState() {
 }
 
 void InterleavedSearcher::update(ExecutionState *current,
-                                 const std::set<ExecutionState*> &addedStates,
-                                 const std::set<ExecutionState*> &removedStates) {
+                                 const StateList &addedStates,
+                                 const StateList &removedStates) {
+  for (std::vector<Searcher*>::const_iterator it = searchers.begin(),
+         ie = searchers.end(); it != ie; ++it)
+    (*it)->update(current, addedStates, removedStates);
+}
+
+/***/
+
+BanditSearcher::BanditSearcher(const std::vector<Searcher*> &_searchers,
+                               unsigned _episodeLength)
+  : searchers(_searchers),
+    rewards(_searchers.size(), 0.),
+    episodes(_searchers.size(), 0.),
+    index(0),
+    episodeLength(std::max(1U, _episodeLength)),
+    remaining(0),
+    episodeStartTime(0.),
+    episodeStartCoverage(0) {
+}
+
+BanditSearcher::~BanditSearcher() {
+  for (std::vector<Searcher*>::const_iterator it = searchers.begin(),
+         ie = searchers.end(); it != ie; ++it)
+    delete *it;
+}
+
+void BanditSearcher::startEpisode() {
+  // Older episodes count less, new coverage gets harder to find as the
+  // run goes on and the best strategy changes with it.
+  const double discount = .95;
+
+  double now = util::getUserTime();
+  uint64_t covered = stats::coveredInstructions;
+  if (episodeStartTime != 0.) {
+    double elapsed = std::max(now - episodeStartTime, 1e-6);
+    for (unsigned i = 0, e = searchers.size(); i != e; ++i) {
+      rewards[i] *= discount;
+      episodes[i] *= discount;
+    }
+    rewards[index] += (covered - episodeStartCoverage) / elapsed;
+    episodes[index] += 1.;
+  }
+
+  // UCB1, with the mean rewards normalized to [0,1].
+  double total = 0., maxMean = 0.;
+  for (unsigned i = 0, e = searchers.size(); i != e; ++i) {
+    total += episodes[i];
+    if (episodes[i] > 0.)
+      maxMean = std::max(maxMean, rewards[i] / episodes[i]);
+  }
+  unsigned best = 0;
+  double bestScore = -1.;
+  for (unsigned i = 0, e = searchers.size(); i != e; ++i) {
+    if (episodes[i] == 0.) { // try every searcher once
+      best = i;
+      break;
+    }
+    double mean = maxMean > 0. ? rewards[i] / episodes[i] / maxMean : 0.;
+    double score = mean + std::sqrt(2. * std::log(total) / episodes[i]);
+    if (score > bestScore) {
+      best = i;
+      bestScore = score;
+    }
+  }
+
+  index = best;
+  remaining = episodeLength;
+  episodeStartTime = now;
+  episodeStartCoverage = covered;
+}
+
+ExecutionState &BanditSearcher::selectState() {
+  if (remaining == 0)
+    startEpisode();
+  --remaining;
+  return searchers[index]->selectState();
+}
+
+void BanditSearcher::update(ExecutionState *current,
+                            const StateList &addedStates,
+                            const StateList &removedStates) {
   for (std::vector<Searcher*>::const_iterator it = searchers.begin(),
          ie = searchers.end(); it != ie; ++it)
     (*it)->update(current, addedStates, removedStates);
@@ -10,6 +10,7 @@
 #ifndef KLEE_SEARCHER_H
 #define KLEE_SEARCHER_H
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/raw_ostream.h"
 #include <vector>
 #include <set>
@@ -27,16 +28,23 @@ namespace klee {
   template<class T> class DiscretePDF;
   class ExecutionState;
   class Executor;
+  struct KInstruction;
 
   class Searcher {
   public:
+    /// A list of states added to or removed from the executor during a
+    /// single step. These are short and are kept in inline storage by
+    /// their owners, so passing them around never touches the heap.
+    typedef llvm::SmallVectorImpl<ExecutionState*> StateList;
+
+    Searcher();
     virtual ~Searcher();
 
     virtual ExecutionState &selectState() = 0;
 
     virtual void update(ExecutionState *current,
-                        const std::set<ExecutionState*> &addedStates,
-                        const std::set<ExecutionState*> &removedStates) = 0;
+                        const StateList &addedStates,
+                        const StateList &removedStates) = 0;
 
     virtual bool empty() = 0;
 
@@ -55,15 +63,15 @@ namespace klee {
     // utility functions
 
     void addState(ExecutionState *es, ExecutionState *current = 0) {
-      std::set<ExecutionState*> tmp;
-      tmp.insert(es);
-      update(current, tmp, std::set<ExecutionState*>());
+      llvm::SmallVector<ExecutionState*, 1> tmp, none;
+      tmp.push_back(es);
+      update(current, tmp, none);
     }
 
     void removeState(ExecutionState *es, ExecutionState *current = 0) {
-      std::set<ExecutionState*> tmp;
-      tmp.insert(es);
-      update(current, std::set<ExecutionState*>(), tmp);
+      llvm::SmallVector<ExecutionState*, 1> tmp, none;
+      tmp.push_back(es);
+      update(current, none, tmp);
     }
 
     enum CoreSearchType {
@@ -76,18 +84,36 @@ namespace klee {
       NURS_Depth,
       NURS_ICnt,
       NURS_CPICnt,
-      NURS_QC
+      NURS_QC,
+      NURS_CovCost
     };
+
+  protected:
+    /// Return this searcher's private handle in the given state. Each
+    /// searcher instance owns one slot of ExecutionState::searcherHandles
+    /// which it may use to remember where the state lives in its
+    /// worklist, so that removal does not need to search for it.
+    unsigned &getHandle(ExecutionState *es);
+
+  private:
+    unsigned handleSlot;
   };
 
   class DFSSearcher : public Searcher {
+    /// Worklist of states, with removed states left behind as null
+    /// entries (never at the back) until the next compaction.
     std::vector<ExecutionState*> states;
+    unsigned numRemoved;
+
+    void compact();
 
   public:
+    DFSSearcher() : numRemoved(0) {}
+
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return states.empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "DFSSearcher\n";
@@ -95,13 +121,23 @@ namespace klee {
   };
 
   class BFSSearcher : public Searcher {
+    /// Worklist of states, with removed states left behind as null
+    /// entries (never at the front) until the next compaction. Handles
+    /// are absolute positions, \ref popped is the number of entries
+    /// that have been dropped from the front.
     std::deque<ExecutionState*> states;
+    unsigned popped;
+    unsigned numRemoved;
+
+    void compact();
 
   public:
+    BFSSearcher() : popped(0), numRemoved(0) {}
+
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return states.empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "BFSSearcher\n";
@@ -114,8 +150,8 @@ namespace klee {
   public:
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return states.empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "RandomSearcher\n";
@@ -130,7 +166,8 @@ namespace klee {
       InstCount,
       CPInstCount,
       MinDistToUncovered,
-      CoveringNew
+      CoveringNew,
+      CoveragePerCost
     };
 
   private:
@@ -146,8 +183,8 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty();
     void printName(llvm::raw_ostream &os) {
       os << "WeightedRandomSearcher::";
@@ -158,6 +195,7 @@ namespace klee {
       case CPInstCount        : os << "CPInstCount\n"; return;
       case MinDistToUncovered : os << "MinDistToUncovered\n"; return;
       case CoveringNew        : os << "CoveringNew\n"; return;
+      case CoveragePerCost    : os << "CoveragePerCost\n"; return;
       default                 : os << "<unknown type>\n"; return;
       }
     }
@@ -172,8 +210,8 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty();
     void printName(llvm::raw_ostream &os) {
       os << "RandomPathSearcher\n";
@@ -195,8 +233,8 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return baseSearcher->empty() && statesAtMerge.empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "MergingSearcher\n";
@@ -218,14 +256,49 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return baseSearcher->empty() && statesAtMerge.empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "BumpMergingSearcher\n";
     }
   };
 
+  /// Merges states automatically where control flow joins, at the
+  /// immediate post-dominators of conditional branches, rather than at
+  /// klee_merge() calls. The first state to reach a join point waits
+  /// there; each later one is merged into it, or takes its place if the
+  /// merge is refused.
+  class AutoMergingSearcher : public Searcher {
+    Executor &executor;
+    Searcher *baseSearcher;
+    unsigned maxSelects;
+    std::map<KInstruction*, ExecutionState*> statesAtMerge;
+    /// States let go from a join point, with their instruction count at
+    /// the time, so that they are not stopped there again.
+    std::map<ExecutionState*, uint64_t> released;
+    std::map<llvm::Function*, std::set<llvm::BasicBlock*> > joinBlocks;
+
+  private:
+    const std::set<llvm::BasicBlock*> &getJoinBlocks(llvm::Function *f);
+    KInstruction *getMergePoint(ExecutionState &es);
+    void release(ExecutionState *es);
+
+  public:
+    AutoMergingSearcher(Executor &executor, Searcher *baseSearcher,
+                        unsigned maxSelects);
+    ~AutoMergingSearcher();
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const StateList &addedStates,
+                const StateList &removedStates);
+    bool empty() { return baseSearcher->empty() && statesAtMerge.empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "AutoMergingSearcher\n";
+    }
+  };
+
   class BatchingSearcher : public Searcher {
     Searcher *baseSearcher;
     double timeBudget;
@@ -243,8 +316,8 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return baseSearcher->empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "<BatchingSearcher> timeBudget: " << timeBudget
@@ -266,8 +339,8 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return baseSearcher->empty() && pausedStates.empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "IterativeDeepeningTimeSearcher\n";
@@ -286,8 +359,8 @@ namespace klee {
 
     ExecutionState &selectState();
     void update(ExecutionState *current,
-                const std::set<ExecutionState*> &addedStates,
-                const std::set<ExecutionState*> &removedStates);
+                const StateList &addedStates,
+                const StateList &removedStates);
     bool empty() { return searchers[0]->empty(); }
     void printName(llvm::raw_ostream &os) {
       os << "<InterleavedSearcher> containing "
@@ -299,6 +372,43 @@ namespace klee {
     }
   };
 
+  /// Runs several searchers like InterleavedSearcher, but treats them as
+  /// the arms of a multi-armed bandit: the chosen searcher selects states
+  /// for an episode of a fixed number of instructions, is rewarded with
+  /// the instructions newly covered per CPU second of the episode, and
+  /// the next searcher is picked with UCB1 over discounted rewards.
+  class BanditSearcher : public Searcher {
+    typedef std::vector<Searcher*> searchers_ty;
+
+    searchers_ty searchers;
+    /// Discounted sum of rewards and number of episodes, per searcher.
+    std::vector<double> rewards, episodes;
+    unsigned index;
+    unsigned episodeLength, remaining;
+    double episodeStartTime;
+    uint64_t episodeStartCoverage;
+
+    void startEpisode();
+
+  public:
+    BanditSearcher(const searchers_ty &_searchers, unsigned _episodeLength);
+    ~BanditSearcher();
+
+    ExecutionState &selectState();
+    void update(ExecutionState *current,
+                const StateList &addedStates,
+                const StateList &removedStates);
+    bool empty() { return searchers[0]->empty(); }
+    void printName(llvm::raw_ostream &os) {
+      os << "<BanditSearcher> episodeLength: " << episodeLength
+         << ", containing " << searchers.size() << " searchers:\n";
+      for (searchers_ty::iterator it = searchers.begin(), ie = searchers.end();
+           it != ie; ++it)
+        (*it)->printName(os);
+      os << "</BanditSearcher>\n";
+    }
+  };
+
 }
 
 #endif
@@ -58,6 +58,16 @@ KTestObject *SeedInfo::getNextInput(const MemoryObject *mo,
   }
 }
 
+void SeedInfo::bindRawInput(const MemoryObject *mo, const Array *array) {
+  std::vector<unsigned char> &values = assignment.bindings[array];
+  values.assign(mo->size, 0);
+  if (!input->numObjects)
+    return;
+  KTestObject *raw = &input->objects[0];
+  for (unsigned i = 0; i != mo->size && inputPosition < raw->numBytes; ++i)
+    values[i] = raw->bytes[inputPosition++];
+}
+
 void SeedInfo::patchSeed(const ExecutionState &state, 
                          ref<Expr> condition,
                          TimingSolver *solver) {
@@ -27,15 +27,32 @@ namespace klee {
     KTest *input;
     unsigned inputPosition;
     std::set<struct KTestObject*> used;
+    /// For seeds restoring a checkpointed state, the path length (in
+    /// instructions) at which the state was checkpointed; 0 otherwise.
+    uint64_t resumeAt;
+    /// Whether the input was imported from another tool's queue, as a
+    /// single object of raw bytes (see bindRawInput()).
+    bool external;
+    /// Whether the state running the input follows it without forking
+    /// until it covers new code (see Executor::releaseSyncedState()).
+    bool followOnly;
     
   public:
     explicit
     SeedInfo(KTest *_input) : assignment(true),
                              input(_input),
-                             inputPosition(0) {}
+                             inputPosition(0),
+                             resumeAt(0),
+                             external(false),
+                             followOnly(false) {}
     
     KTestObject *getNextInput(const MemoryObject *mo,
                              bool byName);
+
+    /// Bind the next mo->size bytes of an external input to array. The
+    /// raw bytes are spread over the objects in the order they are made
+    /// symbolic (inputPosition is the byte offset), padded with zeros.
+    void bindRawInput(const MemoryObject *mo, const Array *array);
     
     /// Patch the seed so that condition is satisfied while retaining as
     /// many of the seed values as possible.
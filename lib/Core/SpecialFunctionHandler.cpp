@@ -23,11 +23,18 @@
 #include "MemoryManager.h"
 
 #if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #else
+#include "llvm/Instructions.h"
 #include "llvm/Module.h"
 #endif
 #include "llvm/ADT/Twine.h"
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+#include "llvm/Support/CallSite.h"
+#else
+#include "llvm/IR/CallSite.h"
+#endif
 
 #include <errno.h>
 
@@ -174,12 +181,36 @@ void SpecialFunctionHandler::prepare() {
 void SpecialFunctionHandler::bind() {
   unsigned N = sizeof(handlerInfo)/sizeof(handlerInfo[0]);
 
+  std::map<const Function*, unsigned> indices;
   for (unsigned i=0; i<N; ++i) {
     HandlerInfo &hi = handlerInfo[i];
     Function *f = executor.kmodule->module->getFunction(hi.name);
     
-    if (f && (!hi.doNotOverride || f->isDeclaration()))
+    if (f && (!hi.doNotOverride || f->isDeclaration())) {
       handlers[f] = std::make_pair(hi.handler, hi.hasReturnValue);
+      indices[f] = i;
+    }
+  }
+
+  // Resolve direct call sites now so that calls through them need no
+  // lookup in the handler map.
+  for (std::vector<KFunction*>::iterator it = executor.kmodule->functions.begin(),
+         ie = executor.kmodule->functions.end(); it != ie; ++it) {
+    KFunction *kf = *it;
+    for (unsigned i=0; i<kf->numInstructions; ++i) {
+      Instruction *inst = kf->instructions[i]->inst;
+      if (!isa<CallInst>(inst) && !isa<InvokeInst>(inst))
+        continue;
+
+      KCallInstruction *kci = static_cast<KCallInstruction*>(kf->instructions[i]);
+      CallSite cs(inst);
+      Function *f = dyn_cast<Function>(cs.getCalledValue()->stripPointerCasts());
+      if (!f)
+        continue;
+      std::map<const Function*, unsigned>::iterator index = indices.find(f);
+      kci->callee = f;
+      kci->specialHandler = index == indices.end() ? 0 : index->second + 1;
+    }
   }
 }
 
@@ -188,21 +219,31 @@ bool SpecialFunctionHandler::handle(ExecutionState &state,
                                     Function *f,
                                     KInstruction *target,
                                     std::vector< ref<Expr> > &arguments) {
-  handlers_ty::iterator it = handlers.find(f);
-  if (it != handlers.end()) {    
-    Handler h = it->second.first;
-    bool hasReturnValue = it->second.second;
-     // FIXME: Check this... add test?
-    if (!hasReturnValue && !target->inst->use_empty()) {
-      executor.terminateStateOnExecError(state, 
-                                         "expected return value from void special function");
-    } else {
-      (this->*h)(state, target, arguments);
-    }
-    return true;
+  Handler h;
+  bool hasReturnValue;
+  KCallInstruction *kci = static_cast<KCallInstruction*>(target);
+  if (kci->callee && kci->callee == f) {
+    if (!kci->specialHandler)
+      return false;
+    HandlerInfo &hi = handlerInfo[kci->specialHandler - 1];
+    h = hi.handler;
+    hasReturnValue = hi.hasReturnValue;
+  } else {
+    handlers_ty::iterator it = handlers.find(f);
+    if (it == handlers.end())
+      return false;
+    h = it->second.first;
+    hasReturnValue = it->second.second;
+  }
+
+  // FIXME: Check this... add test?
+  if (!hasReturnValue && !target->inst->use_empty()) {
+    executor.terminateStateOnExecError(state, 
+                                       "expected return value from void special function");
   } else {
-    return false;
+    (this->*h)(state, target, arguments);
   }
+  return true;
 }
 
 /****/
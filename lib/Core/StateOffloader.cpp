@@ -0,0 +1,125 @@
+//===-- StateOffloader.cpp ------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "Common.h"
+
+#include "StateOffloader.h"
+
+#include "AddressSpace.h"
+#include "Memory.h"
+
+#include "klee/ExecutionState.h"
+#include "klee/Interpreter.h"
+
+#include "llvm/ADT/StringExtras.h"
+
+#include <cassert>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace klee;
+
+/***/
+
+StateOffloader::StateOffloader(InterpreterHandler *_handler)
+  : handler(_handler), nextId(0) {
+}
+
+StateOffloader::~StateOffloader() {
+  for (std::map<const ExecutionState*, SwapRecord>::iterator
+         it = swapped.begin(), ie = swapped.end(); it != ie; ++it)
+    unlink(it->second.path.c_str());
+}
+
+uint64_t StateOffloader::suspend(ExecutionState &state) {
+  assert(!state.suspended && "state already suspended");
+
+  // Objects owned by this address space are reachable from no other
+  // state, so their stores can be dropped without affecting anyone else.
+  AddressSpace &as = state.addressSpace;
+  std::vector<ObjectState*> victims;
+  uint64_t bytes = 0;
+  for (MemoryMap::iterator it = as.objects.begin(), ie = as.objects.end();
+       it != ie; ++it) {
+    ObjectState *os = it->second;
+    if (os->copyOnWriteOwner != as.cowKey || os->refCount != 1 ||
+        os->readOnly || !os->size)
+      continue;
+    victims.push_back(os);
+    bytes += os->size;
+  }
+  if (victims.empty())
+    return 0;
+
+  SwapRecord &rec = swapped[&state];
+  rec.path = handler->getOutputFilename("state" + llvm::utostr(++nextId) +
+                                        ".swap");
+  FILE *f = fopen(rec.path.c_str(), "wb");
+  bool ok = f != 0;
+  for (unsigned i = 0, e = victims.size(); ok && i != e; ++i) {
+    ObjectState *os = victims[i];
+    ok = fwrite(os->concreteStore, 1, os->size, f) == os->size;
+  }
+  if (f && fclose(f))
+    ok = false;
+  if (!ok) {
+    klee_warning_once(0, "unable to write state swap file: %s",
+                      rec.path.c_str());
+    unlink(rec.path.c_str());
+    swapped.erase(&state);
+    return 0;
+  }
+
+  for (unsigned i = 0, e = victims.size(); i != e; ++i) {
+    ObjectState *os = victims[i];
+    delete[] os->concreteStore;
+    os->concreteStore = 0;
+  }
+  rec.objects.swap(victims);
+  state.suspended = true;
+
+  return bytes;
+}
+
+void StateOffloader::resume(ExecutionState &state) {
+  assert(state.suspended && "state is not suspended");
+  std::map<const ExecutionState*, SwapRecord>::iterator it =
+    swapped.find(&state);
+  assert(it != swapped.end() && "no swap record for suspended state");
+  SwapRecord &rec = it->second;
+
+  FILE *f = fopen(rec.path.c_str(), "rb");
+  if (!f)
+    klee_error("unable to open state swap file: %s", rec.path.c_str());
+  for (std::vector<ObjectState*>::iterator oi = rec.objects.begin(),
+         oe = rec.objects.end(); oi != oe; ++oi) {
+    ObjectState *os = *oi;
+    os->concreteStore = new uint8_t[os->size];
+    if (fread(os->concreteStore, 1, os->size, f) != os->size)
+      klee_error("unable to read state swap file: %s", rec.path.c_str());
+  }
+  fclose(f);
+  unlink(rec.path.c_str());
+
+  swapped.erase(it);
+  state.suspended = false;
+}
+
+void StateOffloader::discard(ExecutionState &state) {
+  assert(state.suspended && "state is not suspended");
+  std::map<const ExecutionState*, SwapRecord>::iterator it =
+    swapped.find(&state);
+  assert(it != swapped.end() && "no swap record for suspended state");
+  unlink(it->second.path.c_str());
+
+  // The stores are gone; leave the objects in a state their destructor
+  // can cope with (delete[] of null is a no-op).
+  swapped.erase(it);
+  state.suspended = false;
+}
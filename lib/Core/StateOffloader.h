@@ -0,0 +1,61 @@
+//===-- StateOffloader.h ----------------------------------------*- C++ -*-===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef KLEE_STATEOFFLOADER_H
+#define KLEE_STATEOFFLOADER_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace klee {
+  class ExecutionState;
+  class InterpreterHandler;
+  class ObjectState;
+
+  /// Moves the memory contents of cold states out to disk so that a
+  /// run which is over the memory cap does not have to kill them.
+  ///
+  /// Only the concrete backing stores of objects that the state owns
+  /// exclusively (its copy-on-write delta from its ancestors) are
+  /// written out. Everything shared with other states -- expressions,
+  /// constraints, arrays, and unmodified objects -- stays resident since
+  /// swapping it out would not release any memory.
+  class StateOffloader {
+  private:
+    struct SwapRecord {
+      std::string path;
+      std::vector<ObjectState*> objects;
+    };
+
+    InterpreterHandler *handler;
+    std::map<const ExecutionState*, SwapRecord> swapped;
+    unsigned nextId;
+
+  public:
+    StateOffloader(InterpreterHandler *_handler);
+    ~StateOffloader();
+
+    /// Write out the contents of the given state and release them.
+    ///
+    /// \return The number of bytes released (0 if nothing could be).
+    uint64_t suspend(ExecutionState &state);
+
+    /// Read back the contents of a suspended state.
+    void resume(ExecutionState &state);
+
+    /// Forget a suspended state which is about to be destroyed.
+    void discard(ExecutionState &state);
+
+    unsigned getNumSuspended() const { return swapped.size(); }
+  };
+}
+
+#endif
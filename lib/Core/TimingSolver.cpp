@@ -42,7 +42,7 @@ bool TimingSolver::evaluate(const ExecutionState& state, ref<Expr> expr,
   sys::Process::GetTimeUsage(delta,user,sys);
   delta -= now;
   stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
+  state.addQueryCost(delta.usec()/1000000.);
 
   return success;
 }
@@ -66,7 +66,7 @@ bool TimingSolver::mustBeTrue(const ExecutionState& state, ref<Expr> expr,
   sys::Process::GetTimeUsage(delta,user,sys);
   delta -= now;
   stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
+  state.addQueryCost(delta.usec()/1000000.);
 
   return success;
 }
@@ -113,7 +113,7 @@ bool TimingSolver::getValue(const ExecutionState& state, ref<Expr> expr,
   sys::Process::GetTimeUsage(delta,user,sys);
   delta -= now;
   stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
+  state.addQueryCost(delta.usec()/1000000.);
 
   return success;
 }
@@ -137,7 +137,7 @@ TimingSolver::getInitialValues(const ExecutionState& state,
   sys::Process::GetTimeUsage(delta,user,sys);
   delta -= now;
   stats::solverTime += delta.usec();
-  state.queryCost += delta.usec()/1000000.;
+  state.addQueryCost(delta.usec()/1000000.);
   
   return success;
 }
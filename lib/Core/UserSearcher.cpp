@@ -32,8 +32,19 @@ namespace {
 			clEnumValN(Searcher::NURS_ICnt, "nurs:icnt", "use NURS with Instr-Count"),
 			clEnumValN(Searcher::NURS_CPICnt, "nurs:cpicnt", "use NURS with CallPath-Instr-Count"),
 			clEnumValN(Searcher::NURS_QC, "nurs:qc", "use NURS with Query-Cost"),
+			clEnumValN(Searcher::NURS_CovCost, "nurs:covcost", "use NURS with Coverage-New per predicted solver cost"),
 			clEnumValEnd));
 
+  cl::opt<bool>
+  UseBanditSearch("use-bandit-search",
+                  cl::desc("Pick between the searchers given with --search using a multi-armed bandit rewarding coverage per CPU second, instead of round-robin (default=off)"),
+                  cl::init(false));
+
+  cl::opt<unsigned>
+  BanditEpisodeInstructions("bandit-episode-instructions",
+                            cl::desc("Number of instructions each searcher runs before the bandit picks again when using --use-bandit-search (default=1000)"),
+                            cl::init(1000));
+
   cl::opt<bool>
   UseIterativeDeepeningTimeSearch("use-iterative-deepening-time-search", 
                                     cl::desc("(experimental)"));
@@ -62,6 +73,15 @@ namespace {
   UseBumpMerge("use-bump-merge", 
            cl::desc("Enable support for klee_merge() (extra experimental)"));
 
+  cl::opt<bool>
+  UseAutoMerge("use-auto-merge", 
+               cl::desc("Merge states automatically where control flow joins (experimental)"));
+
+  cl::opt<unsigned>
+  AutoMergeMaxSelects("auto-merge-max-selects",
+                      cl::desc("Do not merge states differing in more than this many registers and bytes of memory when using --use-auto-merge (0=unlimited, default=256)"),
+                      cl::init(256));
+
 }
 
 
@@ -70,7 +90,8 @@ bool klee::userSearcherRequiresMD2U() {
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CovNew) != CoreSearch.end() ||
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_ICnt) != CoreSearch.end() ||
 	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CPICnt) != CoreSearch.end() ||
-	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end());
+	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_QC) != CoreSearch.end() ||
+	  std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::NURS_CovCost) != CoreSearch.end());
 }
 
 
@@ -87,6 +108,7 @@ Searcher *getNewSearcher(Searcher::CoreSearchType type, Executor &executor) {
   case Searcher::NURS_ICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::InstCount); break;
   case Searcher::NURS_CPICnt: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CPInstCount); break;
   case Searcher::NURS_QC: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::QueryCost); break;
+  case Searcher::NURS_CovCost: searcher = new WeightedRandomSearcher(WeightedRandomSearcher::CoveragePerCost); break;
   }
 
   return searcher;
@@ -109,7 +131,10 @@ Searcher *klee::constructUserSearcher(Executor &executor) {
     for (unsigned i=1; i<CoreSearch.size(); i++)
       s.push_back(getNewSearcher(CoreSearch[i], executor));
     
-    searcher = new InterleavedSearcher(s);
+    if (UseBanditSearch)
+      searcher = new BanditSearcher(s, BanditEpisodeInstructions);
+    else
+      searcher = new InterleavedSearcher(s);
   }
 
   if (UseBatchingSearch) {
@@ -123,6 +148,9 @@ Searcher *klee::constructUserSearcher(Executor &executor) {
     searcher = new MergingSearcher(executor, searcher);
   } else if (UseBumpMerge) {
     searcher = new BumpMergingSearcher(executor, searcher);
+  } else if (UseAutoMerge) {
+    assert(std::find(CoreSearch.begin(), CoreSearch.end(), Searcher::RandomPath) == CoreSearch.end()); // merged states are terminated under the process tree, see --use-merge
+    searcher = new AutoMergingSearcher(executor, searcher, AutoMergeMaxSelects);
   }
   
   if (UseIterativeDeepeningTimeSearch) {
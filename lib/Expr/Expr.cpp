@@ -495,6 +495,25 @@ unsigned Array::computeHash() {
 }
 
 std::map<unsigned, const Array *> Array::symbolicArraySingletonMap;
+std::multimap<unsigned, const Array *> Array::constantArrayPool;
+
+unsigned Array::contentHash() const {
+  unsigned res = (size * Expr::MAGIC_HASH_CONSTANT + domain) *
+    Expr::MAGIC_HASH_CONSTANT + range;
+  for (unsigned i = 0, e = constantValues.size(); i != e; ++i)
+    res = (res * Expr::MAGIC_HASH_CONSTANT) + constantValues[i]->hash();
+  return res;
+}
+
+bool Array::hasSameContents(const Array &b) const {
+  if (size != b.size || domain != b.domain || range != b.range ||
+      constantValues.size() != b.constantValues.size())
+    return false;
+  for (unsigned i = 0, e = constantValues.size(); i != e; ++i)
+    if (constantValues[i]->compareContents(*b.constantValues[i]))
+      return false;
+  return true;
+}
 
 const Array * Array::CreateArray(const std::string &_name, uint64_t _size,
 		const ref<ConstantExpr> *constantValuesBegin,
@@ -518,17 +537,49 @@ const Array * Array::CreateArray(const std::string &_name, uint64_t _size,
 	return 0;
 }
 
+const Array * Array::CreateUniqueConstantArray(const std::string &_name,
+		uint64_t _size,
+		const ref<ConstantExpr> *constantValuesBegin,
+		const ref<ConstantExpr> *constantValuesEnd,
+		Expr::Width _domain, Expr::Width _range){
+
+	const Array * array = new Array(_name, _size, constantValuesBegin, constantValuesEnd, _domain,_range);
+	assert(array->isConstantArray() && "expected a constant array");
+	unsigned hash = array->contentHash();
+	std::pair<std::multimap<unsigned, const Array *>::iterator,
+	          std::multimap<unsigned, const Array *>::iterator> range =
+		Array::constantArrayPool.equal_range(hash);
+	for (; range.first != range.second; ++range.first) {
+		if (range.first->second->hasSameContents(*array)) {
+			delete array;
+			return range.first->second;
+		}
+	}
+	Array::constantArrayPool.insert(std::make_pair(hash, array));
+	return array;
+}
+
 /***/
 
-ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
-  // rollback index when possible... 
+namespace {
+  /// An entry of the cache of reads over long update lists. Holding the
+  /// UpdateList keeps its nodes alive, so a matching head pointer really
+  /// is the same list.
+  struct ReadCacheEntry {
+    UpdateList updates;
+    ref<Expr> index, result;
 
-  // XXX this doesn't really belong here... there are basically two
-  // cases, one is rebuild, where we want to optimistically try various
-  // optimizations when the index has changed, and the other is 
-  // initial creation, where we expect the ObjectState to have constructed
-  // a smart UpdateList so it is not worth rescanning.
+    ReadCacheEntry() : updates(0, 0) {}
+  };
+}
+
+static const unsigned ReadCacheSize = 1024;
+/// Reads over shorter lists are cheap enough to resolve every time.
+static const unsigned ReadCacheMinUpdates = 16;
+static ReadCacheEntry readCache[ReadCacheSize];
 
+static ref<Expr> resolveRead(const UpdateList &ul, const ref<Expr> &index) {
+  // Skip the writes which provably do not alias the index.
   const UpdateNode *un = ul.head;
   for (; un; un=un->next) {
     ref<Expr> cond = EqExpr::create(index, un->index);
@@ -541,9 +592,46 @@ ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
     }
   }
 
+  // Nothing in the list can alias a concrete index into a constant array.
+  if (!un && ul.root && ul.root->isConstantArray()) {
+    if (ConstantExpr *CE = dyn_cast<ConstantExpr>(index)) {
+      uint64_t i = CE->getZExtValue();
+      if (i < ul.root->size)
+        return ul.root->constantValues[i];
+    }
+  }
+
   return ReadExpr::alloc(ul, index);
 }
 
+ref<Expr> ReadExpr::create(const UpdateList &ul, ref<Expr> index) {
+  // rollback index when possible... 
+
+  // XXX this doesn't really belong here... there are basically two
+  // cases, one is rebuild, where we want to optimistically try various
+  // optimizations when the index has changed, and the other is 
+  // initial creation, where we expect the ObjectState to have constructed
+  // a smart UpdateList so it is not worth rescanning.
+
+  if (ul.getSize() < ReadCacheMinUpdates)
+    return resolveRead(ul, index);
+
+  // Reads over heavily written objects are rebuilt over and over (by
+  // visitors and the constraint manager), so memoize them on the
+  // (update list, index) pair.
+  uintptr_t key = (uintptr_t) ul.head ^ index->hash();
+  ReadCacheEntry &entry = readCache[(key ^ (key >> 16)) % ReadCacheSize];
+  if (entry.updates.head == ul.head && entry.updates.root == ul.root &&
+      entry.index == index)
+    return entry.result;
+
+  ref<Expr> result = resolveRead(ul, index);
+  entry.updates = ul;
+  entry.index = index;
+  entry.result = result;
+  return result;
+}
+
 int ReadExpr::compareContents(const Expr &b) const { 
   return updates.compare(static_cast<const ReadExpr&>(b).updates);
 }
@@ -18,6 +18,8 @@
 #include "klee/util/ExprPPrinter.h"
 
 #include "llvm/ADT/APInt.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -102,8 +104,8 @@ namespace {
 
   /// ParserImpl - Parser implementation.
   class ParserImpl : public Parser {
-    typedef std::map<const std::string, const Identifier*> IdentifierTabTy;
-    typedef std::map<const Identifier*, ExprHandle> ExprSymTabTy;
+    typedef llvm::StringMap<Identifier*> IdentifierTabTy;
+    typedef llvm::DenseMap<const Identifier*, ExprHandle> ExprSymTabTy;
     typedef std::map<const Identifier*, VersionHandle> VersionSymTabTy;
 
     const std::string Filename;
@@ -114,7 +116,8 @@ namespace {
     unsigned MaxErrors;
     unsigned NumErrors;
 
-    // FIXME: Use LLVM symbol tables?
+    /// IdentifierTab - The uniqued identifiers, which are owned by the
+    /// parser. Lookups do not copy the token text.
     IdentifierTabTy IdentifierTab;
 
     std::map<const Identifier*, const ArrayDecl*> ArraySymTab;
@@ -329,6 +332,12 @@ namespace {
                                         MaxErrors(~0u),
                                         NumErrors(0) {}
 
+    virtual ~ParserImpl() {
+      for (IdentifierTabTy::iterator it = IdentifierTab.begin(),
+             ie = IdentifierTab.end(); it != ie; ++it)
+        delete it->second;
+    }
+
     /// Initialize - Initialize the parsing state. This must be called
     /// prior to the start of parsing.
     void Initialize() {
@@ -352,16 +361,10 @@ namespace {
 }
 
 const Identifier *ParserImpl::GetOrCreateIdentifier(const Token &Tok) {
-  // FIXME: Make not horribly inefficient please.
   assert(Tok.kind == Token::Identifier && "Expected only identifier tokens.");
-  std::string Name(Tok.start, Tok.length);
-  IdentifierTabTy::iterator it = IdentifierTab.find(Name);
-  if (it != IdentifierTab.end())
-    return it->second;
-
-  Identifier *I = new Identifier(Name);
-  IdentifierTab.insert(std::make_pair(Name, I));
-
+  Identifier *&I = IdentifierTab[StringRef(Tok.start, Tok.length)];
+  if (!I)
+    I = new Identifier(std::string(Tok.start, Tok.length));
   return I;
 }
 
@@ -1460,10 +1463,14 @@ ExprResult ParserImpl::ParseNumberToken(Expr::Width Type, const Token &Tok) {
     }
   }
 
-  // This is a simple but slow way to handle overflow.
-  APInt Val(RadixBits * N, 0);
-  APInt RadixVal(Val.getBitWidth(), Radix);
-  APInt DigitVal(Val.getBitWidth(), 0);
+  // Numbers whose digits fit in 64 bits, which is nearly all of them,
+  // are accumulated directly. Wider ones use APInt, which is a simple
+  // but slow way to handle overflow.
+  unsigned Width = RadixBits * N;
+  uint64_t SmallVal = 0;
+  APInt Val(Width, 0);
+  APInt RadixVal(Width, Radix);
+  APInt DigitVal(Width, 0);
   for (unsigned i=0; i<N; ++i) {
     unsigned Digit, Char = S[i];
     
@@ -1486,13 +1493,26 @@ ExprResult ParserImpl::ParseNumberToken(Expr::Width Type, const Token &Tok) {
       return Builder->Constant(0, Type);
     }
 
-    DigitVal = Digit;
-    Val = Val * RadixVal + DigitVal;
+    if (Width <= 64) {
+      SmallVal = SmallVal * Radix + Digit;
+    } else {
+      DigitVal = Digit;
+      Val = Val * RadixVal + DigitVal;
+    }
   }
 
   // FIXME: Actually do the check for overflow.
-  if (HasMinus)
+  if (Width <= 64) {
+    if (HasMinus)
+      SmallVal = -SmallVal;
+    if (Width < 64)
+      SmallVal &= ((uint64_t) 1 << Width) - 1;
+    if (Type <= 64)
+      return ExprResult(Builder->Constant(SmallVal, Type));
+    Val = APInt(Width, SmallVal);
+  } else if (HasMinus) {
     Val = -Val;
+  }
 
   if (Type < Val.getBitWidth())
     Val=Val.trunc(Type);
@@ -1509,7 +1529,9 @@ TypeResult ParserImpl::ParseTypeSpecifier() {
   assert(Tok.kind == Token::KWWidth && "Unexpected token.");
 
   // FIXME: Need APInt technically.
-  int width = atoi(std::string(Tok.start+1,Tok.length-1).c_str());
+  unsigned width = 0;
+  for (unsigned i = 1; i != Tok.length; ++i)
+    width = width * 10 + (Tok.start[i] - '0');
   ConsumeToken();
 
   // FIXME: We should impose some sort of maximum just for sanity?
@@ -0,0 +1,652 @@
+//===-- QueryLog.cpp ------------------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A binary query log is a header followed by a sequence of records, each
+// starting with its tag. All integers are unsigned LEB128. Arrays,
+// update nodes and expressions are numbered in the order their records
+// appear, and are referred to by those numbers in later records (update
+// node numbers start at 1, with 0 meaning the empty list). A reset
+// record forgets all of them, which bounds the memory used on both
+// sides of a long log.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Internal/Support/QueryLog.h"
+
+#include "klee/Constraints.h"
+#include "klee/ExprBuilder.h"
+#include "klee/Solver.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace klee;
+
+namespace {
+  const char logMagic[8] = { 'K', 'L', 'E', 'E', 'Q', 'L', 'O', 'G' };
+  const unsigned logVersion = 1;
+
+  enum RecordTag {
+    ArrayRecord = 1,
+    UpdateRecord,
+    ExprRecord,
+    QueryRecord,
+    ResetRecord
+  };
+
+  /// Encoded records are handed to the output thread in chunks of
+  /// about this size.
+  const size_t chunkSize = 1 << 20;
+
+  /// At most this many chunks wait for the output thread before the
+  /// writer blocks.
+  const size_t maxPendingChunks = 16;
+
+  /// The writer starts over (with a reset record) once it holds this
+  /// many expressions.
+  const size_t maxLoggedExprs = 1 << 20;
+}
+
+QueryLogEntry::QueryLogEntry(const QueryLogEntry &b)
+  : exprs(b.exprs),
+    type(b.type),
+    query(b.query),
+    instruction(b.instruction),
+    objects(b.objects) {
+}
+
+QueryLogEntry::QueryLogEntry(const Query &_query,
+                             Type _type,
+                             const std::vector<const Array*> *_objects)
+  : exprs(_query.constraints.begin(), _query.constraints.end()),
+    type(_type),
+    query(_query.expr),
+    instruction(0) {
+  if (_objects)
+    objects = *_objects;
+}
+
+/***/
+
+struct QueryLogWriter::OutputQueue {
+  int fd;
+  bool failed;
+  bool done;
+  std::deque<std::string*> chunks;
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  pthread_t thread;
+
+  static void *run(void *arg) {
+    OutputQueue *q = static_cast<OutputQueue*>(arg);
+    pthread_mutex_lock(&q->lock);
+    for (;;) {
+      while (q->chunks.empty() && !q->done)
+        pthread_cond_wait(&q->changed, &q->lock);
+      if (q->chunks.empty())
+        break;
+      std::string *chunk = q->chunks.front();
+      pthread_mutex_unlock(&q->lock);
+
+      const char *p = chunk->data();
+      size_t left = chunk->size();
+      bool ok = true;
+      while (left) {
+        ssize_t n = ::write(q->fd, p, left);
+        if (n < 0) {
+          if (errno == EINTR)
+            continue;
+          ok = false;
+          break;
+        }
+        p += n;
+        left -= n;
+      }
+      delete chunk;
+
+      pthread_mutex_lock(&q->lock);
+      q->chunks.pop_front();
+      if (!ok)
+        q->failed = true;
+      pthread_cond_broadcast(&q->changed);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+  }
+};
+
+QueryLogWriter::QueryLogWriter(const std::string &path, std::string &error)
+  : queue(0) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    error = strerror(errno);
+    return;
+  }
+
+  queue = new OutputQueue();
+  queue->fd = fd;
+  queue->failed = false;
+  queue->done = false;
+  pthread_mutex_init(&queue->lock, 0);
+  pthread_cond_init(&queue->changed, 0);
+  if (pthread_create(&queue->thread, 0, OutputQueue::run, queue)) {
+    error = "unable to start query log thread";
+    close(fd);
+    delete queue;
+    queue = 0;
+    return;
+  }
+
+  buffer.append(logMagic, sizeof(logMagic));
+  writeUnsigned(logVersion);
+}
+
+QueryLogWriter::~QueryLogWriter() {
+  if (!queue)
+    return;
+
+  flushBuffer(true);
+  pthread_mutex_lock(&queue->lock);
+  queue->done = true;
+  pthread_cond_broadcast(&queue->changed);
+  pthread_mutex_unlock(&queue->lock);
+  pthread_join(queue->thread, 0);
+
+  close(queue->fd);
+  pthread_cond_destroy(&queue->changed);
+  pthread_mutex_destroy(&queue->lock);
+  delete queue;
+}
+
+void QueryLogWriter::flushBuffer(bool force) {
+  if (buffer.empty() || (!force && buffer.size() < chunkSize))
+    return;
+
+  std::string *chunk = new std::string();
+  chunk->swap(buffer);
+  buffer.reserve(chunkSize + chunkSize / 4);
+
+  pthread_mutex_lock(&queue->lock);
+  while (queue->chunks.size() >= maxPendingChunks)
+    pthread_cond_wait(&queue->changed, &queue->lock);
+  queue->chunks.push_back(chunk);
+  pthread_cond_broadcast(&queue->changed);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+void QueryLogWriter::writeUnsigned(uint64_t value) {
+  do {
+    unsigned char byte = value & 0x7F;
+    value >>= 7;
+    if (value)
+      byte |= 0x80;
+    buffer.push_back(byte);
+  } while (value);
+}
+
+void QueryLogWriter::writeString(const std::string &s) {
+  writeUnsigned(s.size());
+  buffer.append(s);
+}
+
+void QueryLogWriter::writeAPInt(const llvm::APInt &value) {
+  for (unsigned i = 0, e = value.getNumWords(); i != e; ++i)
+    writeUnsigned(value.getRawData()[i]);
+}
+
+unsigned QueryLogWriter::writeArray(const Array *array) {
+  std::map<const Array*, unsigned>::iterator it = arrayIds.find(array);
+  if (it != arrayIds.end())
+    return it->second;
+
+  buffer.push_back(ArrayRecord);
+  writeString(array->name);
+  writeUnsigned(array->size);
+  writeUnsigned(array->domain);
+  writeUnsigned(array->range);
+  writeUnsigned(array->constantValues.size());
+  for (unsigned i = 0, e = array->constantValues.size(); i != e; ++i)
+    writeAPInt(array->constantValues[i]->getAPValue());
+
+  unsigned id = arrayIds.size();
+  arrayIds.insert(std::make_pair(array, id));
+  return id;
+}
+
+unsigned QueryLogWriter::writeUpdates(const UpdateList &ul) {
+  if (!ul.head)
+    return 0;
+
+  // Find the newest node already written, then write the rest oldest
+  // first, so that every node refers to one written before it.
+  std::vector<const UpdateNode*> pending;
+  unsigned next = 0;
+  for (const UpdateNode *un = ul.head; un; un = un->next) {
+    std::map<const UpdateNode*, unsigned>::iterator it = updateIds.find(un);
+    if (it != updateIds.end()) {
+      next = it->second;
+      break;
+    }
+    pending.push_back(un);
+  }
+
+  unsigned array = writeArray(ul.root);
+  for (std::vector<const UpdateNode*>::reverse_iterator it = pending.rbegin(),
+         ie = pending.rend(); it != ie; ++it) {
+    const UpdateNode *un = *it;
+    unsigned index = writeExpr(un->index);
+    unsigned value = writeExpr(un->value);
+    buffer.push_back(UpdateRecord);
+    writeUnsigned(array);
+    writeUnsigned(next);
+    writeUnsigned(index);
+    writeUnsigned(value);
+
+    next = updates.size() + 1;
+    updateIds.insert(std::make_pair(un, next));
+    updates.push_back(UpdateList(ul.root, un));
+  }
+  return next;
+}
+
+unsigned QueryLogWriter::writeExpr(const ref<Expr> &e) {
+  ExprHashMap<unsigned>::iterator it = exprIds.find(e);
+  if (it != exprIds.end())
+    return it->second;
+
+  // Kids first, so that the record below only refers back.
+  unsigned kids[3];
+  unsigned updatesId = 0, array = 0;
+  if (const ReadExpr *re = dyn_cast<ReadExpr>(e)) {
+    updatesId = writeUpdates(re->updates);
+    array = writeArray(re->updates.root);
+  }
+  unsigned numKids = e->getNumKids();
+  assert(numKids <= 3 && "unexpected number of kids");
+  for (unsigned i = 0; i != numKids; ++i)
+    kids[i] = writeExpr(e->getKid(i));
+
+  buffer.push_back(ExprRecord);
+  writeUnsigned(e->getKind());
+  switch (e->getKind()) {
+  case Expr::Constant: {
+    ConstantExpr *ce = cast<ConstantExpr>(e);
+    writeUnsigned(ce->getWidth());
+    writeAPInt(ce->getAPValue());
+    break;
+  }
+  case Expr::Read:
+    writeUnsigned(array);
+    writeUnsigned(updatesId);
+    break;
+  case Expr::Extract:
+    writeUnsigned(cast<ExtractExpr>(e)->offset);
+    writeUnsigned(e->getWidth());
+    break;
+  case Expr::ZExt:
+  case Expr::SExt:
+    writeUnsigned(e->getWidth());
+    break;
+  default:
+    break;
+  }
+  for (unsigned i = 0; i != numKids; ++i)
+    writeUnsigned(kids[i]);
+
+  unsigned id = exprIds.size();
+  exprIds.insert(std::make_pair(e, id));
+  return id;
+}
+
+void QueryLogWriter::write(const QueryLogEntry &entry,
+                           const QueryLogResult &result) {
+  if (!queue)
+    return;
+
+  if (exprIds.size() > maxLoggedExprs) {
+    buffer.push_back(ResetRecord);
+    exprIds.clear();
+    updateIds.clear();
+    updates.clear();
+    arrayIds.clear();
+  }
+
+  std::vector<unsigned> constraints;
+  for (QueryLogEntry::exprs_ty::const_iterator it = entry.exprs.begin(),
+         ie = entry.exprs.end(); it != ie; ++it)
+    constraints.push_back(writeExpr(*it));
+  unsigned query = writeExpr(entry.query);
+  std::vector<unsigned> objects;
+  for (std::vector<const Array*>::const_iterator it = entry.objects.begin(),
+         ie = entry.objects.end(); it != ie; ++it)
+    objects.push_back(writeArray(*it));
+
+  buffer.push_back(QueryRecord);
+  writeUnsigned(entry.type);
+  writeUnsigned(entry.instruction);
+  writeUnsigned(constraints.size());
+  for (unsigned i = 0, e = constraints.size(); i != e; ++i)
+    writeUnsigned(constraints[i]);
+  writeUnsigned(query);
+  writeUnsigned(objects.size());
+  for (unsigned i = 0, e = objects.size(); i != e; ++i)
+    writeUnsigned(objects[i]);
+  // Failed queries have a negative time; store it offset by one so
+  // that it is still unsigned.
+  writeUnsigned(result.time < 0 ? 0 : (uint64_t) (result.time * 1e6) + 1);
+  writeUnsigned(result.result);
+
+  flushBuffer(false);
+}
+
+/***/
+
+QueryLogReader::QueryLogReader(const char *data, size_t size,
+                               ExprBuilder *_builder)
+  : pos((const unsigned char*) data),
+    end((const unsigned char*) data + size),
+    builder(_builder) {
+  uint64_t version;
+  if (!isQueryLog(data, size)) {
+    fail("not a binary query log");
+  } else {
+    pos += sizeof(logMagic);
+    if (!readUnsigned(version) || version != logVersion)
+      fail("unsupported query log version");
+  }
+}
+
+bool QueryLogReader::isQueryLog(const char *data, size_t size) {
+  return size >= sizeof(logMagic) &&
+    memcmp(data, logMagic, sizeof(logMagic)) == 0;
+}
+
+bool QueryLogReader::fail(const char *message) {
+  if (error.empty())
+    error = message;
+  pos = end;
+  return false;
+}
+
+bool QueryLogReader::readUnsigned(uint64_t &value) {
+  value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (pos == end)
+      return fail("truncated query log");
+    unsigned char byte = *pos++;
+    value |= (uint64_t) (byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return fail("malformed integer in query log");
+}
+
+bool QueryLogReader::readUnsigned(unsigned &value) {
+  uint64_t v;
+  if (!readUnsigned(v))
+    return false;
+  if (v != (unsigned) v)
+    return fail("integer out of range in query log");
+  value = v;
+  return true;
+}
+
+bool QueryLogReader::readString(std::string &s) {
+  uint64_t size;
+  if (!readUnsigned(size))
+    return false;
+  if (size > (uint64_t) (end - pos))
+    return fail("truncated query log");
+  s.assign((const char*) pos, size);
+  pos += size;
+  return true;
+}
+
+bool QueryLogReader::readAPInt(unsigned width, llvm::APInt &value) {
+  if (width == 0)
+    return fail("invalid width in query log");
+  std::vector<uint64_t> words((width + 63) / 64);
+  for (unsigned i = 0, e = words.size(); i != e; ++i)
+    if (!readUnsigned(words[i]))
+      return false;
+  value = llvm::APInt(width, words.size(), &words[0]);
+  return true;
+}
+
+bool QueryLogReader::readExprId(ref<Expr> &e) {
+  unsigned id;
+  if (!readUnsigned(id))
+    return false;
+  if (id >= exprs.size())
+    return fail("invalid expression reference in query log");
+  e = exprs[id];
+  return true;
+}
+
+bool QueryLogReader::readArrayId(const Array *&array) {
+  unsigned id;
+  if (!readUnsigned(id))
+    return false;
+  if (id >= arrays.size())
+    return fail("invalid array reference in query log");
+  array = arrays[id];
+  return true;
+}
+
+bool QueryLogReader::readArray() {
+  std::string name;
+  unsigned size, domain, range, numValues;
+  if (!readString(name) || !readUnsigned(size) || !readUnsigned(domain) ||
+      !readUnsigned(range) || !readUnsigned(numValues))
+    return false;
+  if (numValues && numValues != size)
+    return fail("invalid constant array in query log");
+
+  std::vector< ref<ConstantExpr> > values;
+  for (unsigned i = 0; i != numValues; ++i) {
+    llvm::APInt value;
+    if (!readAPInt(range, value))
+      return false;
+    values.push_back(ConstantExpr::alloc(value));
+  }
+
+  const ref<ConstantExpr> *begin = values.empty() ? 0 : &values[0];
+  arrays.push_back(Array::CreateArray(name, size, begin,
+                                      begin + values.size(),
+                                      domain, range));
+  return true;
+}
+
+bool QueryLogReader::readUpdate() {
+  const Array *array;
+  unsigned next;
+  ref<Expr> index, value;
+  if (!readArrayId(array) || !readUnsigned(next) ||
+      !readExprId(index) || !readExprId(value))
+    return false;
+  if (next > updates.size())
+    return fail("invalid update reference in query log");
+
+  UpdateList ul = next ? updates[next - 1] : UpdateList(array, 0);
+  ul.extend(index, value);
+  updates.push_back(ul);
+  return true;
+}
+
+bool QueryLogReader::readExpr() {
+  unsigned kind;
+  if (!readUnsigned(kind))
+    return false;
+
+  ref<Expr> e;
+  switch (kind) {
+  case Expr::Constant: {
+    unsigned width;
+    llvm::APInt value;
+    if (!readUnsigned(width) || !readAPInt(width, value))
+      return false;
+    e = builder->Constant(value);
+    break;
+  }
+
+  case Expr::Read: {
+    const Array *array;
+    unsigned head;
+    ref<Expr> index;
+    if (!readArrayId(array) || !readUnsigned(head) || !readExprId(index))
+      return false;
+    if (head > updates.size())
+      return fail("invalid update reference in query log");
+    e = builder->Read(head ? updates[head - 1] : UpdateList(array, 0), index);
+    break;
+  }
+
+  case Expr::Extract: {
+    unsigned offset, width;
+    ref<Expr> kid;
+    if (!readUnsigned(offset) || !readUnsigned(width) || !readExprId(kid))
+      return false;
+    e = builder->Extract(kid, offset, width);
+    break;
+  }
+
+  case Expr::ZExt:
+  case Expr::SExt: {
+    unsigned width;
+    ref<Expr> kid;
+    if (!readUnsigned(width) || !readExprId(kid))
+      return false;
+    e = kind == Expr::ZExt ? builder->ZExt(kid, width) :
+      builder->SExt(kid, width);
+    break;
+  }
+
+  case Expr::NotOptimized:
+  case Expr::Not: {
+    ref<Expr> kid;
+    if (!readExprId(kid))
+      return false;
+    e = kind == Expr::Not ? builder->Not(kid) : builder->NotOptimized(kid);
+    break;
+  }
+
+  case Expr::Select: {
+    ref<Expr> cond, t, f;
+    if (!readExprId(cond) || !readExprId(t) || !readExprId(f))
+      return false;
+    e = builder->Select(cond, t, f);
+    break;
+  }
+
+  default: {
+    if (kind < Expr::Concat || kind > Expr::LastKind ||
+        kind == Expr::Extract || kind == Expr::ZExt || kind == Expr::SExt)
+      return fail("invalid expression kind in query log");
+    ref<Expr> l, r;
+    if (!readExprId(l) || !readExprId(r))
+      return false;
+    switch (kind) {
+#define BINARY_CASE(T) case Expr::T: e = builder->T(l, r); break;
+    BINARY_CASE(Concat)
+    BINARY_CASE(Add)
+    BINARY_CASE(Sub)
+    BINARY_CASE(Mul)
+    BINARY_CASE(UDiv)
+    BINARY_CASE(SDiv)
+    BINARY_CASE(URem)
+    BINARY_CASE(SRem)
+    BINARY_CASE(And)
+    BINARY_CASE(Or)
+    BINARY_CASE(Xor)
+    BINARY_CASE(Shl)
+    BINARY_CASE(LShr)
+    BINARY_CASE(AShr)
+    BINARY_CASE(Eq)
+    BINARY_CASE(Ne)
+    BINARY_CASE(Ult)
+    BINARY_CASE(Ule)
+    BINARY_CASE(Ugt)
+    BINARY_CASE(Uge)
+    BINARY_CASE(Slt)
+    BINARY_CASE(Sle)
+    BINARY_CASE(Sgt)
+    BINARY_CASE(Sge)
+#undef BINARY_CASE
+    default:
+      return fail("invalid expression kind in query log");
+    }
+  }
+  }
+
+  exprs.push_back(e);
+  return true;
+}
+
+bool QueryLogReader::next(QueryLogEntry &entry, QueryLogResult &result) {
+  while (pos != end) {
+    switch (*pos++) {
+    case ArrayRecord:
+      if (!readArray())
+        return false;
+      break;
+
+    case UpdateRecord:
+      if (!readUpdate())
+        return false;
+      break;
+
+    case ExprRecord:
+      if (!readExpr())
+        return false;
+      break;
+
+    case ResetRecord:
+      exprs.clear();
+      updates.clear();
+      arrays.clear();
+      break;
+
+    case QueryRecord: {
+      unsigned type, numConstraints, numObjects;
+      uint64_t time;
+      if (!readUnsigned(type) || !readUnsigned(entry.instruction) ||
+          !readUnsigned(numConstraints))
+        return false;
+      if (type > QueryLogEntry::Cex)
+        return fail("invalid query type in query log");
+      entry.type = (QueryLogEntry::Type) type;
+
+      entry.exprs.resize(numConstraints);
+      for (unsigned i = 0; i != numConstraints; ++i)
+        if (!readExprId(entry.exprs[i]))
+          return false;
+      if (!readExprId(entry.query) || !readUnsigned(numObjects))
+        return false;
+      entry.objects.resize(numObjects);
+      for (unsigned i = 0; i != numObjects; ++i)
+        if (!readArrayId(entry.objects[i]))
+          return false;
+
+      if (!readUnsigned(time) || !readUnsigned(result.result))
+        return false;
+      result.time = time ? (time - 1) / 1e6 : -1;
+      return true;
+    }
+
+    default:
+      return fail("invalid record in query log");
+    }
+  }
+  return false;
+}
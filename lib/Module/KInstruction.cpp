@@ -9,6 +9,12 @@
 
 #include "klee/Internal/Module/KInstruction.h"
 
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 3)
+#include "llvm/IR/Instructions.h"
+#else
+#include "llvm/Instructions.h"
+#endif
+
 using namespace llvm;
 using namespace klee;
 
@@ -17,3 +23,75 @@ using namespace klee;
 KInstruction::~KInstruction() {
   delete[] operands;
 }
+
+/***/
+
+namespace {
+  /// Operations over W bit values, held zero extended in 64 bits.
+  template<unsigned W>
+  struct Bits {
+    static uint64_t trunc(uint64_t v) {
+      return v & (~(uint64_t) 0 >> (64 - W));
+    }
+    static int64_t sext(uint64_t v) {
+      return (int64_t) (v << (64 - W)) >> (64 - W);
+    }
+
+    static uint64_t add(uint64_t l, uint64_t r) { return trunc(l + r); }
+    static uint64_t sub(uint64_t l, uint64_t r) { return trunc(l - r); }
+    static uint64_t mul(uint64_t l, uint64_t r) { return trunc(l * r); }
+    static uint64_t and_(uint64_t l, uint64_t r) { return l & r; }
+    static uint64_t or_(uint64_t l, uint64_t r) { return l | r; }
+    static uint64_t xor_(uint64_t l, uint64_t r) { return l ^ r; }
+
+    static uint64_t eq(uint64_t l, uint64_t r) { return l == r; }
+    static uint64_t ne(uint64_t l, uint64_t r) { return l != r; }
+    static uint64_t ugt(uint64_t l, uint64_t r) { return l > r; }
+    static uint64_t uge(uint64_t l, uint64_t r) { return l >= r; }
+    static uint64_t ult(uint64_t l, uint64_t r) { return l < r; }
+    static uint64_t ule(uint64_t l, uint64_t r) { return l <= r; }
+    static uint64_t sgt(uint64_t l, uint64_t r) { return sext(l) > sext(r); }
+    static uint64_t sge(uint64_t l, uint64_t r) { return sext(l) >= sext(r); }
+    static uint64_t slt(uint64_t l, uint64_t r) { return sext(l) < sext(r); }
+    static uint64_t sle(uint64_t l, uint64_t r) { return sext(l) <= sext(r); }
+
+    static KInstruction::ConcreteOp get(const Instruction *i) {
+      switch (i->getOpcode()) {
+      case Instruction::Add: return add;
+      case Instruction::Sub: return sub;
+      case Instruction::Mul: return mul;
+      case Instruction::And: return and_;
+      case Instruction::Or: return or_;
+      case Instruction::Xor: return xor_;
+      case Instruction::ICmp:
+        switch (cast<ICmpInst>(i)->getPredicate()) {
+        case ICmpInst::ICMP_EQ: return eq;
+        case ICmpInst::ICMP_NE: return ne;
+        case ICmpInst::ICMP_UGT: return ugt;
+        case ICmpInst::ICMP_UGE: return uge;
+        case ICmpInst::ICMP_ULT: return ult;
+        case ICmpInst::ICMP_ULE: return ule;
+        case ICmpInst::ICMP_SGT: return sgt;
+        case ICmpInst::ICMP_SGE: return sge;
+        case ICmpInst::ICMP_SLT: return slt;
+        case ICmpInst::ICMP_SLE: return sle;
+        default: return 0;
+        }
+      default:
+        return 0;
+      }
+    }
+  };
+}
+
+KInstruction::ConcreteOp KInstruction::getConcreteOp(const Instruction *i,
+                                                     unsigned width) {
+  switch (width) {
+  case 1: return Bits<1>::get(i);
+  case 8: return Bits<8>::get(i);
+  case 16: return Bits<16>::get(i);
+  case 32: return Bits<32>::get(i);
+  case 64: return Bits<64>::get(i);
+  default: return 0;
+  }
+}
@@ -241,8 +241,7 @@ void KModule::addInternalFunction(const char* functionName){
   internalFunctions.insert(internalFunction);
 }
 
-void KModule::prepare(const Interpreter::ModuleOptions &opts,
-                      InterpreterHandler *ih) {
+void KModule::transform(const Interpreter::ModuleOptions &opts) {
   if (!MergeAtExit.empty()) {
     Function *mergeFn = module->getFunction("klee_merge");
     if (!mergeFn) {
@@ -349,14 +348,6 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
     );
   module = linkWithLibrary(module, LibPath.str());
 
-  // Add internal functions which are not used to check if instructions
-  // have been already visited
-  if (opts.CheckDivZero)
-    addInternalFunction("klee_div_zero_check");
-  if (opts.CheckOvershift)
-    addInternalFunction("klee_overshift_check");
-
-
   // Needs to happen after linking (since ctors/dtors can be modified)
   // and optimization (since global optimization can rewrite lists).
   injectStaticConstructorsAndDestructors(module);
@@ -388,6 +379,19 @@ void KModule::prepare(const Interpreter::ModuleOptions &opts,
   f = module->getFunction("memset");
   if (f && f->use_empty()) f->eraseFromParent();
 #endif
+}
+
+void KModule::prepare(const Interpreter::ModuleOptions &opts,
+                      InterpreterHandler *ih) {
+  if (!opts.Prepared)
+    transform(opts);
+
+  // Add internal functions which are not used to check if instructions
+  // have been already visited
+  if (opts.CheckDivZero)
+    addInternalFunction("klee_div_zero_check");
+  if (opts.CheckOvershift)
+    addInternalFunction("klee_overshift_check");
 
   // Write out the .ll assembly file. We truncate long lines to work
   // around a kcachegrind parsing bug (it puts them on new lines), so
@@ -560,12 +564,25 @@ KFunction::KFunction(llvm::Function *_function,
       case Instruction::InsertValue:
       case Instruction::ExtractValue:
         ki = new KGEPInstruction(); break;
+      case Instruction::Call:
+      case Instruction::Invoke:
+        ki = new KCallInstruction(); break;
       default:
         ki = new KInstruction(); break;
       }
 
       ki->inst = it;      
       ki->dest = registerMap[it];
+      // Decode the result width once instead of on every execution.
+      ki->width = it->getType()->isSized() ?
+        km->targetData->getTypeSizeInBits(it->getType()) : 0;
+      ki->concreteOp = 0;
+      if (it->getNumOperands() == 2) {
+        LLVM_TYPE_Q Type *t = it->getOperand(0)->getType();
+        if (t->isIntegerTy() || t->isPointerTy())
+          ki->concreteOp = KInstruction::getConcreteOp(
+            it, km->targetData->getTypeSizeInBits(t));
+      }
 
       if (isa<CallInst>(it) || isa<InvokeInst>(it)) {
         CallSite cs(it);
@@ -49,6 +49,7 @@
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #endif
 
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Support/Path.h"
@@ -59,11 +60,17 @@
 #include "llvm/IR/CallSite.h"
 #endif
 
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <map>
 #include <set>
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace llvm;
 using namespace klee;
@@ -175,33 +182,218 @@ GetAllUndefinedSymbols(Module *M, std::set<std::string> &UndefinedSymbols) {
 }
 
 
-/*!  A helper function for linkBCA() which cleans up
- *   memory allocated by that function.
- */
-static void CleanUpLinkBCA(std::vector<Module*> &archiveModules)
-{
-  for (std::vector<Module*>::iterator I = archiveModules.begin(), E = archiveModules.end();
-      I != E; ++I)
+/// The definitions in an archive of bitcode modules: for each external
+/// symbol, the index of the first member which defines it.
+typedef std::map<std::string, unsigned> ArchiveIndex;
+
+static const char archiveIndexMagic[] = "klee-archive-index-v1";
+
+/// Read the index saved for the given archive, if it is still current.
+static bool readArchiveIndex(const std::string &indexPath,
+                             const struct stat &archiveStat,
+                             unsigned numMembers, ArchiveIndex &index) {
+  std::ifstream in(indexPath.c_str());
+  if (!in)
+    return false;
+
+  std::string magic;
+  unsigned long long size, mtime;
+  unsigned members;
+  if (!(in >> magic >> size >> mtime >> members) ||
+      magic != archiveIndexMagic ||
+      size != (unsigned long long) archiveStat.st_size ||
+      mtime != (unsigned long long) archiveStat.st_mtime ||
+      members != numMembers)
+    return false;
+
+  unsigned member;
+  std::string name;
+  while (in >> member && in.get() == ' ' && std::getline(in, name)) {
+    if (member >= numMembers)
+      return false;
+    index.insert(std::make_pair(name, member));
+  }
+  return in.eof();
+}
+
+/// Return where the index of the given archive is saved: the per-user
+/// cache directory ($XDG_CACHE_HOME/klee or ~/.cache/klee), never next
+/// to the archive, whose directory may be read-only and is hashed into
+/// the module cache key. Empty if there is no usable cache directory.
+static std::string getArchiveIndexPath(const std::string &archivePath) {
+  std::string dir;
+  const char *env = getenv("XDG_CACHE_HOME");
+  if (env && *env) {
+    dir = env;
+  } else if ((env = getenv("HOME")) && *env) {
+    dir = std::string(env) + "/.cache";
+    mkdir(dir.c_str(), 0700);
+  } else {
+    return "";
+  }
+  dir += "/klee";
+  if (mkdir(dir.c_str(), 0775) < 0 && errno != EEXIST)
+    return "";
+
+  // Archives with the same name in different places (build and install
+  // trees) get their own index.
+  std::string path = archivePath;
+  if (char *real = realpath(archivePath.c_str(), 0)) {
+    path = real;
+    free(real);
+  }
+  uint64_t hash = 14695981039346656037ULL;
+  for (unsigned i = 0, e = path.size(); i != e; ++i) {
+    hash ^= (unsigned char) path[i];
+    hash *= 1099511628211ULL;
+  }
+  char suffix[32];
+  sprintf(suffix, ".%016llx.index", (unsigned long long) hash);
+  return dir + "/" + sys::path::filename(archivePath).str() + suffix;
+}
+
+/// Save the index for the given archive. Failure is not an error, the
+/// index is simply rebuilt next time.
+static void writeArchiveIndex(const std::string &indexPath,
+                              const struct stat &archiveStat,
+                              unsigned numMembers, const ArchiveIndex &index) {
+  std::string tmpPath = indexPath + "." + llvm::utostr(getpid()) + ".tmp";
   {
-    delete (*I);
+    std::ofstream out(tmpPath.c_str());
+    if (!out)
+      return;
+    out << archiveIndexMagic << " "
+        << (unsigned long long) archiveStat.st_size << " "
+        << (unsigned long long) archiveStat.st_mtime << " "
+        << numMembers << "\n";
+    for (ArchiveIndex::const_iterator it = index.begin(), ie = index.end();
+         it != ie; ++it)
+      out << it->second << " " << it->first << "\n";
+    if (!out) {
+      out.close();
+      unlink(tmpPath.c_str());
+      return;
+    }
+  }
+  if (rename(tmpPath.c_str(), indexPath.c_str()) < 0)
+    unlink(tmpPath.c_str());
+}
+
+/// Add the external definitions of an archive member to the index.
+/// Members are loaded lazily, so only their symbol tables are read.
+static bool indexArchiveMember(const object::Archive::Child &member,
+                               unsigned memberIndex, ArchiveIndex &index,
+                               std::string &errorMessage) {
+  llvm::raw_string_ostream SS(errorMessage);
+
+  StringRef memberName;
+  if (member.getName(memberName) != errc::success) {
+    errorMessage="Archive member does not have a name!\n";
+    return false;
+  }
+  KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Indexing archive member "
+                       << memberName << "\n");
+
+  OwningPtr<object::Binary> child;
+  if (member.getAsBinary(child) == object::object_error::success) {
+    if (object::ObjectFile *o = dyn_cast<object::ObjectFile>(child.get()))
+      SS << "Object file " << o->getFileName().data() <<
+            " in archive is not supported";
+    else
+      SS << "Archive member " << memberName << " is not bitcode";
+    SS.flush();
+    return false;
   }
+
+  OwningPtr<MemoryBuffer> buff;
+  if (error_code ec = member.getMemoryBuffer(buff)) {
+    SS << "Failed to get MemoryBuffer: " <<ec.message();
+    SS.flush();
+    return false;
+  }
+  if (!buff) {
+    errorMessage="Buffer was NULL!";
+    return false;
+  }
+
+  // On success the module takes ownership of the buffer.
+  Module *M = getLazyBitcodeModule(buff.get(), getGlobalContext(),
+                                   &errorMessage);
+  if (!M) {
+    SS << "Loading module failed : " << errorMessage << "\n";
+    SS.flush();
+    return false;
+  }
+  buff.take();
+
+  // Unmaterialized functions are not declarations.
+  for (Module::iterator I = M->begin(), E = M->end(); I != E; ++I)
+    if (I->hasName() && !I->isDeclaration() && !I->hasLocalLinkage())
+      index.insert(std::make_pair(I->getName().str(), memberIndex));
+  for (Module::global_iterator I = M->global_begin(), E = M->global_end();
+       I != E; ++I)
+    if (I->hasName() && !I->isDeclaration() && !I->hasLocalLinkage())
+      index.insert(std::make_pair(I->getName().str(), memberIndex));
+  for (Module::alias_iterator I = M->alias_begin(), E = M->alias_end();
+       I != E; ++I)
+    if (I->hasName() && !I->hasLocalLinkage())
+      index.insert(std::make_pair(I->getName().str(), memberIndex));
+
+  delete M;
+  return true;
+}
+
+/// Parse an archive member and link it into the composite module.
+static bool linkArchiveMember(const object::Archive::Child &member,
+                              Module *composite, std::string &errorMessage) {
+  llvm::raw_string_ostream SS(errorMessage);
+
+  OwningPtr<MemoryBuffer> buff;
+  if (error_code ec = member.getMemoryBuffer(buff)) {
+    SS << "Failed to get MemoryBuffer: " <<ec.message();
+    SS.flush();
+    return false;
+  }
+
+  Module *M = ParseBitcodeFile(buff.get(), getGlobalContext(), &errorMessage);
+  if (!M) {
+    SS << "Loading module failed : " << errorMessage << "\n";
+    SS.flush();
+    return false;
+  }
+  KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Linking in "
+                       << M->getModuleIdentifier() << "\n");
+
+  bool failed = Linker::LinkModules(composite, M, Linker::DestroySource,
+                                    &errorMessage);
+  delete M;
+  if (failed) {
+    SS << "Linking archive module with composite failed:" << errorMessage;
+    SS.flush();
+    return false;
+  }
+  return true;
 }
 
 /*! A helper function for klee::linkWithLibrary() that links in an archive of bitcode
  *  modules into a composite bitcode module
  *
+ *  Only the members defining symbols which are undefined in the
+ *  composite module (directly or through earlier members) are parsed.
+ *  They are found through an index from symbols to members, which is
+ *  saved in the user's cache directory so later runs don't have to
+ *  rebuild it.
+ *
  *  \param[in] archive Archive of bitcode modules
+ *  \param[in] archivePath The file the archive was read from
  *  \param[in,out] composite The bitcode module to link against the archive
  *  \param[out] errorMessage Set to an error message if linking fails
  *
  *  \return True if linking succeeds otherwise false
  */
-static bool linkBCA(object::Archive* archive, Module* composite, std::string& errorMessage)
+static bool linkBCA(object::Archive* archive, const std::string &archivePath,
+                    Module* composite, std::string& errorMessage)
 {
-  llvm::raw_string_ostream SS(errorMessage);
-  std::vector<Module*> archiveModules;
-
-  // Is this efficient? Could we use StringRef instead?
   std::set<std::string> undefinedSymbols;
   GetAllUndefinedSymbols(composite, undefinedSymbols);
 
@@ -212,153 +404,55 @@ static bool linkBCA(object::Archive* archive, Module* composite, std::string& er
     return true;
   }
 
-  KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Loading modules\n");
-  // Load all bitcode files in to memory so we can examine their symbols
+  std::vector<object::Archive::Child> members;
   for (object::Archive::child_iterator AI = archive->begin_children(),
        AE = archive->end_children(); AI != AE; ++AI)
-  {
-
-    StringRef memberName;
-    error_code ec = AI->getName(memberName);
-
-    if ( ec == errc::success )
-    {
-      KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Loading archive member " << memberName << "\n");
-    }
-    else
-    {
-      errorMessage="Archive member does not have a name!\n";
-      return false;
-    }
-
-    OwningPtr<object::Binary> child;
-    ec = AI->getAsBinary(child);
-    if (ec != object::object_error::success)
-    {
-      // If we can't open as a binary object file its hopefully a bitcode file
-
-      OwningPtr<MemoryBuffer> buff; // Once this is destroyed will Module still be valid??
-      Module *Result = 0;
-
-      if (error_code ec = AI->getMemoryBuffer(buff))
-      {
-        SS << "Failed to get MemoryBuffer: " <<ec.message();
-        SS.flush();
+    members.push_back(*AI);
+
+  ArchiveIndex index;
+  std::string indexPath = getArchiveIndexPath(archivePath);
+  struct stat archiveStat;
+  bool haveStat = !indexPath.empty() &&
+    stat(archivePath.c_str(), &archiveStat) == 0;
+  if (!haveStat ||
+      !readArchiveIndex(indexPath, archiveStat, members.size(), index)) {
+    index.clear();
+    for (unsigned i = 0, e = members.size(); i != e; ++i)
+      if (!indexArchiveMember(members[i], i, index, errorMessage))
         return false;
-      }
-
-      if (buff)
-      {
-        // FIXME: Maybe load bitcode file lazily? Then if we need to link, materialise the module
-        Result = ParseBitcodeFile(buff.get(), getGlobalContext(), &errorMessage);
+    if (haveStat)
+      writeArchiveIndex(indexPath, archiveStat, members.size(), index);
+  }
+  KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Archive index has "
+                       << index.size() << " symbols in "
+                       << members.size() << " members\n");
+
+  // Link in every member defining a currently undefined symbol, then
+  // look again at what those members left undefined, until nothing
+  // more can be resolved from the archive.
+  std::vector<bool> linked(members.size());
+  for (;;) {
+    std::set<unsigned> toLink;
+    for (std::set<std::string>::iterator S = undefinedSymbols.begin(),
+           SE = undefinedSymbols.end(); S != SE; ++S) {
+      ArchiveIndex::iterator it = index.find(*S);
+      if (it != index.end() && !linked[it->second])
+        toLink.insert(it->second);
+    }
+    if (toLink.empty())
+      break;
 
-        if(!Result)
-        {
-          SS << "Loading module failed : " << errorMessage << "\n";
-          SS.flush();
-          return false;
-        }
-        archiveModules.push_back(Result);
-      }
-      else
-      {
-        errorMessage="Buffer was NULL!";
+    for (std::set<unsigned>::iterator it = toLink.begin(),
+           ie = toLink.end(); it != ie; ++it) {
+      if (!linkArchiveMember(members[*it], composite, errorMessage))
         return false;
-      }
-
-    }
-    else if (object::ObjectFile *o = dyn_cast<object::ObjectFile>(child.get()))
-    {
-      SS << "Object file " << o->getFileName().data() <<
-            " in archive is not supported";
-      SS.flush();
-      return false;
-    }
-    else
-    {
-      SS << "Loading archive child with error "<< ec.message();
-      SS.flush();
-      return false;
+      linked[*it] = true;
     }
 
+    GetAllUndefinedSymbols(composite, undefinedSymbols);
   }
 
-  KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Loaded " << archiveModules.size() << " modules\n");
-
-
-  std::set<std::string> previouslyUndefinedSymbols;
-
-  // Walk through the modules looking for definitions of undefined symbols
-  // if we find a match we should link that module in.
-  unsigned int passCounter=0;
-  do
-  {
-    unsigned int modulesLoadedOnPass=0;
-    previouslyUndefinedSymbols = undefinedSymbols;
-
-    for (size_t i = 0, j = archiveModules.size(); i < j; ++i)
-    {
-      // skip empty archives
-      if (archiveModules[i] == 0)
-        continue;
-      Module * M = archiveModules[i];
-      // Look for the undefined symbols in the composite module
-      for (std::set<std::string>::iterator S = undefinedSymbols.begin(), SE = undefinedSymbols.end();
-         S != SE; ++S)
-      {
-
-        // FIXME: We aren't handling weak symbols here!
-        // However the algorithm used in LLVM3.2 didn't seem to either
-        // so maybe it doesn't matter?
-
-        if ( GlobalValue* GV = dyn_cast_or_null<GlobalValue>(M->getValueSymbolTable().lookup(*S)))
-        {
-          if (GV->isDeclaration()) continue; // Not a definition
-
-          KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Found " << GV->getName() <<
-              " in " << M->getModuleIdentifier() << "\n");
-
-
-          if (Linker::LinkModules(composite, M, Linker::DestroySource, &errorMessage))
-          {
-            // Linking failed
-            SS << "Linking archive module with composite failed:" << errorMessage;
-            SS.flush();
-            CleanUpLinkBCA(archiveModules);
-            return false;
-          }
-          else
-          {
-            // Link succeed, now clean up
-            modulesLoadedOnPass++;
-            KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Linking succeeded.\n");
-
-            delete M;
-            archiveModules[i] = 0;
-
-            // We need to recompute the undefined symbols in the composite module
-            // after linking
-            GetAllUndefinedSymbols(composite, undefinedSymbols);
-
-            break; // Look for symbols in next module
-          }
-
-        }
-      }
-    }
-
-    passCounter++;
-    KLEE_DEBUG_WITH_TYPE("klee_linker", dbgs() << "Completed " << passCounter <<
-                " linker passes.\n" << modulesLoadedOnPass <<
-                " modules loaded on the last pass\n");
-  } while (undefinedSymbols != previouslyUndefinedSymbols); // Iterate until we reach a fixed point
-
-
-  // What's left in archiveModules we don't want to link in so free it
-  CleanUpLinkBCA(archiveModules);
-
   return true;
-
 }
 #endif
 
@@ -403,7 +497,7 @@ Module *klee::linkWithLibrary(Module *module,
 
     if (object::Archive *a = dyn_cast<object::Archive>(arch.get())) {
       // Handle in helper
-      if (!linkBCA(a, module, ErrorMessage))
+      if (!linkBCA(a, libraryName, module, ErrorMessage))
         klee_error("Link with library %s failed: %s", libraryName.c_str(),
             ErrorMessage.c_str());
     }
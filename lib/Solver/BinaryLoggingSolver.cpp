@@ -0,0 +1,119 @@
+//===-- BinaryLoggingSolver.cpp -------------------------------------------===//
+//
+//                     The KLEE Symbolic Virtual Machine
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "klee/Solver.h"
+#include "klee/SolverImpl.h"
+#include "klee/Statistics.h"
+#include "klee/Internal/Support/QueryLog.h"
+#include "klee/Internal/System/Time.h"
+
+#include "llvm/Support/raw_ostream.h"
+
+using namespace klee;
+
+class BinaryLoggingSolver : public SolverImpl {
+  Solver *solver;
+  QueryLogWriter writer;
+  int minQueryTimeToLog; // as for QueryLoggingSolver
+  double startTime;
+
+  void startQuery() {
+    startTime = util::getWallTime();
+  }
+
+  void finishQuery(QueryLogEntry entry, bool success, uint64_t result) {
+    double time = util::getWallTime() - startTime;
+    if (minQueryTimeToLog && static_cast<int>(time * 1000) <= minQueryTimeToLog)
+      return;
+    if (minQueryTimeToLog < 0 &&
+        solver->impl->getOperationStatusCode() != SOLVER_RUN_STATUS_TIMEOUT)
+      return;
+
+    Statistic *S = theStatisticManager->getStatisticByName("Instructions");
+    entry.instruction = S ? S->getValue() : 0;
+    writer.write(entry, QueryLogResult(success, result, time));
+  }
+
+public:
+  BinaryLoggingSolver(Solver *_solver, std::string path, int queryTimeToLog,
+                      std::string &error)
+    : solver(_solver),
+      writer(path, error),
+      minQueryTimeToLog(queryTimeToLog),
+      startTime(0) {}
+
+  ~BinaryLoggingSolver() {
+    delete solver;
+  }
+
+  bool computeTruth(const Query& query, bool &isValid) {
+    startQuery();
+    bool success = solver->impl->computeTruth(query, isValid);
+    finishQuery(QueryLogEntry(query, QueryLogEntry::Truth), success, isValid);
+    return success;
+  }
+
+  bool computeValidity(const Query& query, Solver::Validity &result) {
+    startQuery();
+    bool success = solver->impl->computeValidity(query, result);
+    // Validity is -1, 0 or 1.
+    finishQuery(QueryLogEntry(query, QueryLogEntry::Validity), success,
+                result + 1);
+    return success;
+  }
+
+  bool computeValue(const Query& query, ref<Expr> &result) {
+    startQuery();
+    bool success = solver->impl->computeValue(query, result);
+    uint64_t value = 0;
+    if (success)
+      if (ConstantExpr *ce = dyn_cast<ConstantExpr>(result))
+        if (ce->getWidth() <= 64)
+          value = ce->getZExtValue();
+    finishQuery(QueryLogEntry(query, QueryLogEntry::Value), success, value);
+    return success;
+  }
+
+  bool computeInitialValues(const Query& query,
+                            const std::vector<const Array*> &objects,
+                            std::vector< std::vector<unsigned char> > &values,
+                            bool &hasSolution) {
+    startQuery();
+    bool success = solver->impl->computeInitialValues(query, objects, values,
+                                                      hasSolution);
+    finishQuery(QueryLogEntry(query, QueryLogEntry::Cex, &objects), success,
+                hasSolution);
+    return success;
+  }
+
+  SolverRunStatus getOperationStatusCode() {
+    return solver->impl->getOperationStatusCode();
+  }
+
+  char *getConstraintLog(const Query& query) {
+    return solver->impl->getConstraintLog(query);
+  }
+
+  void setCoreSolverTimeout(double timeout) {
+    solver->impl->setCoreSolverTimeout(timeout);
+  }
+};
+
+///
+
+Solver *klee::createBinaryLoggingSolver(Solver *_solver, std::string path,
+                                        int minQueryTimeToLog) {
+  std::string error;
+  BinaryLoggingSolver *impl =
+    new BinaryLoggingSolver(_solver, path, minQueryTimeToLog, error);
+  if (!error.empty())
+    llvm::errs() << "KLEE: WARNING: unable to open query log " << path
+                 << ": " << error << "\n";
+  return new Solver(impl);
+}
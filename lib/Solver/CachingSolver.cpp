@@ -14,6 +14,7 @@
 #include "klee/Expr.h"
 #include "klee/IncompleteSolver.h"
 #include "klee/SolverImpl.h"
+#include "klee/TimerStatIncrementer.h"
 
 #include "SolverStats.h"
 
@@ -148,6 +149,7 @@ void CachingSolver::cacheInsert(const Query& query,
 
 bool CachingSolver::computeValidity(const Query& query,
                                     Solver::Validity &result) {
+  TimerStatIncrementer t(stats::queryCacheTime);
   IncompleteSolver::PartialValidity cachedResult;
   bool tmp, cacheHit = cacheLookup(query, cachedResult);
   
@@ -217,6 +219,7 @@ bool CachingSolver::computeValidity(const Query& query,
 
 bool CachingSolver::computeTruth(const Query& query,
                                  bool &isValid) {
+  TimerStatIncrementer t(stats::queryCacheTime);
   IncompleteSolver::PartialValidity cachedResult;
   bool cacheHit = cacheLookup(query, cachedResult);
 
@@ -13,6 +13,7 @@
 #include "klee/Constraints.h"
 #include "klee/Expr.h"
 #include "klee/IncompleteSolver.h"
+#include "klee/TimerStatIncrementer.h"
 #include "klee/util/ExprEvaluator.h"
 #include "klee/util/ExprRangeEvaluator.h"
 #include "klee/util/ExprVisitor.h"
@@ -20,6 +21,8 @@
 #include "klee/Internal/Support/Debug.h"
 #include "klee/Internal/Support/IntEvaluation.h"
 
+#include "SolverStats.h"
+
 #include "llvm/Support/raw_ostream.h"
 #include <sstream>
 #include <cassert>
@@ -1047,6 +1050,7 @@ static bool propogateValues(const Query& query, CexData &cd,
 
 IncompleteSolver::PartialValidity 
 FastCexSolver::computeTruth(const Query& query) {
+  TimerStatIncrementer t(stats::fastCexTime);
   CexData cd;
 
   bool isValid;
@@ -1059,6 +1063,7 @@ FastCexSolver::computeTruth(const Query& query) {
 }
 
 bool FastCexSolver::computeValue(const Query& query, ref<Expr> &result) {
+  TimerStatIncrementer t(stats::fastCexTime);
   CexData cd;
 
   bool isValid;
@@ -1091,6 +1096,7 @@ FastCexSolver::computeInitialValues(const Query& query,
                                     std::vector< std::vector<unsigned char> >
                                       &values,
                                     bool &hasSolution) {
+  TimerStatIncrementer t(stats::fastCexTime);
   CexData cd;
 
   bool isValid;
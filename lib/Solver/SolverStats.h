@@ -16,11 +16,14 @@ namespace klee {
 namespace stats {
 
   extern Statistic cexCacheTime;
+  extern Statistic fastCexTime;
+  extern Statistic independentTime;
   extern Statistic queries;
   extern Statistic queriesInvalid;
   extern Statistic queriesValid;
   extern Statistic queryCacheHits;
   extern Statistic queryCacheMisses;
+  extern Statistic queryCacheTime;
   extern Statistic queryCexCacheHits;
   extern Statistic queryCexCacheMisses;
   extern Statistic queryConstructTime;
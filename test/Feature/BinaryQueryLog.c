@@ -0,0 +1,28 @@
+// RUN: %llvmgcc %s -emit-llvm -g -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --use-cex-cache=false --use-query-log=all:pc,all:bin %t1.bc 2> %t2.log
+// RUN: %kleaver -print-ast %t.klee-out/all-queries.pc | grep -c "^(query" > %t3.log
+// RUN: %kleaver -print-ast %t.klee-out/all-queries.qlog | grep -c "^(query" > %t4.log
+// RUN: diff %t3.log %t4.log
+// RUN: %kleaver %t.klee-out/all-queries.qlog > %t5.log
+// RUN: grep "total queries = [1-9]" %t5.log
+
+// The binary query log should hold the same queries as the .pc log,
+// and kleaver should be able to evaluate it directly.
+
+#include <assert.h>
+
+int main() {
+  int x, y;
+  klee_make_symbolic(&x, sizeof x);
+  klee_make_symbolic(&y, sizeof y);
+
+  if (x > 10) {
+    if (x + y == 42)
+      assert(y < 32);
+  } else if (y == x) {
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,34 @@
+// RUN: %llvmgcc -emit-llvm -c -g %s -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-seed
+// RUN: %klee --output-dir=%t.klee-seed %t.bc "initial"
+// RUN: test -f %t.klee-seed/test000001.ktest
+// RUN: not test -f %t.klee-seed/test000002.ktest
+
+// Starting from an all-zero seed, each generation negates one more
+// comparison until the fourth reaches the assertion.
+// RUN: %klee --output-dir=%t.klee-out --concolic --only-seed --seed-out=%t.klee-seed/test000001.ktest %t.bc > %t.log 2>&1
+// RUN: ls %t.klee-out | grep -q "assert.err"
+// RUN: grep -q "concolic generation 4" %t.log
+
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --concolic --concolic-generations=2 --only-seed --seed-out=%t.klee-seed/test000001.ktest %t.bc
+// RUN: ls %t.klee-out-2 | not grep -q "assert.err"
+
+#include <assert.h>
+
+int main(int argc, char **argv) {
+  unsigned char buf[4];
+  klee_make_symbolic(buf, sizeof buf, "buf");
+
+  if (argc == 2) {
+    klee_assume((buf[0] == 0) & (buf[1] == 0) & (buf[2] == 0) & (buf[3] == 0));
+    return 0;
+  }
+
+  if (buf[0] == 'b')
+    if (buf[1] == 'a')
+      if (buf[2] == 'd')
+        if (buf[3] == '!')
+          assert(0 && "bad input");
+  return 0;
+}
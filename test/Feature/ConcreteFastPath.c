@@ -0,0 +1,31 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --concrete-fast-path --exit-on-error %t1.bc 2> %t.log
+// RUN: grep "completed paths = 3" %t.log
+// RUN: grep -q "fast path instructions = [1-9]" %t.klee-out/info
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --exit-on-error %t1.bc
+// RUN: not grep "fast path instructions" %t.klee-out/info
+
+// Concrete runs of a block must still stop where symbolic values come
+// into play.
+
+#include <assert.h>
+
+int main() {
+  int table[64];
+  int i, x;
+
+  for (i = 0; i < 64; ++i)
+    table[i] = i * i;
+
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  i = x & 63;
+  if (table[i] == 49)
+    assert(i == 7);
+  else if (x > 100)
+    assert(table[i] != 49);
+
+  return 0;
+}
@@ -0,0 +1,25 @@
+// RUN: %llvmgcc %s -emit-llvm -O2 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --concrete-fast-path --exit-on-error %t1.bc 2> %t.log
+// RUN: grep "completed paths = 2" %t.log
+
+// The header of the loop has a phi node for each of a, b and i; on entry
+// the values of their back edges are not computed yet.
+
+volatile int count = 40;
+
+int main() {
+  unsigned a = 1, b = 0, x;
+  int i, n = count;
+
+  for (i = 0; i < n; ++i) {
+    unsigned t = a + b;
+    b = a;
+    a = t;
+  }
+
+  klee_make_symbolic(&x, sizeof x, "x");
+  if (x == a)
+    return 1;
+  return 0;
+}
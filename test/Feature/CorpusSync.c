@@ -0,0 +1,34 @@
+// RUN: %llvmgcc -emit-llvm -c -g %s -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-2 %t.sync
+// RUN: mkdir -p %t.sync/fuzzer/queue %t.sync/klee/queue
+// RUN: printf 'ZZUF' > %t.sync/fuzzer/queue/id:000000,orig:seed
+// RUN: printf 'old' > %t.sync/klee/queue/id:000000,src:klee
+
+// On its own KLEE never guesses the magic value, which the input of the
+// fuzzer has.
+// RUN: %klee --output-dir=%t.klee-out %t.bc
+// RUN: ls %t.klee-out | not grep "\.abort\.err$"
+// RUN: %klee --output-dir=%t.klee-out-2 --sync-dir=%t.sync %t.bc
+// RUN: ls %t.klee-out-2 | grep -q "\.abort\.err$"
+
+// Tests covering new code are exported to the queue of this instance
+// as raw inputs (the bytes of x), numbered after the entries already
+// there and leaving the queues of the other instances alone.
+// RUN: cat %t.sync/klee/queue/id:000000,src:klee | grep -qx old
+// RUN: cat %t.sync/klee/queue/id:000001,src:klee | wc -c | grep -qx 4
+// RUN: not ls %t.sync/klee/.export
+// RUN: ls %t.sync/fuzzer/queue | grep -c . | grep -qx 1
+
+#include "klee/klee.h"
+
+int main() {
+  unsigned x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (klee_get_value_i32(x) == 0x46555a5a) /* "ZZUF" */
+    klee_abort();
+
+  if (x < 10)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,19 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out --isolate-external-calls --exit-on-error %t1.bc
+
+// Writes made by an isolated external call must be seen by the state
+// that made it.
+
+#include <assert.h>
+#include <string.h>
+
+int main() {
+  char buf[16] = "foo";
+
+  strcat(buf, "bar");
+  assert(strlen(buf) == 6);
+  assert(buf[3] == 'b' && buf[5] == 'r');
+
+  return 0;
+}
@@ -0,0 +1,15 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.cache %t.klee-out %t.klee-out2
+// RUN: %klee --module-cache-dir=%t.cache --output-dir=%t.klee-out %t1.bc 2> %t1.log
+// RUN: not grep -q "prepared module" %t1.log
+// RUN: %klee --module-cache-dir=%t.cache --output-dir=%t.klee-out2 %t1.bc 2> %t2.log
+// RUN: grep -q "Using prepared module" %t2.log
+// RUN: grep -q "completed paths = 2" %t2.log
+
+int main() {
+  int x;
+  klee_make_symbolic(&x, sizeof x);
+  if (x > 10)
+    return 1;
+  return 0;
+}
@@ -0,0 +1,31 @@
+// RUN: %llvmgcc -emit-llvm -c -g %s -o %t.bc
+// RUN: rm -rf %t.klee-out %t.seeds
+// RUN: %klee --output-dir=%t.klee-out %t.bc
+// RUN: mkdir %t.seeds
+// RUN: cp %t.klee-out/*.ktest %t.seeds
+// RUN: cp %t.klee-out/test000001.ktest %t.seeds/dup1.ktest
+// RUN: cp %t.klee-out/test000002.ktest %t.seeds/dup2.ktest
+// RUN: cp %t.klee-out/test000002.ktest %t.seeds/dup3.ktest
+
+// RUN: rm -rf %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out-2 --only-seed --only-replay-seeds --seed-out-dir=%t.seeds %t.bc
+// RUN: ls %t.klee-out-2 | grep -c "\.ktest$" | grep -qx 4
+// RUN: grep -q "shared seed evaluations = [1-9]" %t.klee-out-2/info
+
+// Seeds which agree on the inputs a branch reads are evaluated
+// together; duplicated seeds must still follow their own paths and
+// end up in the same four tests.
+
+int main() {
+  unsigned char x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x < 10) {
+    if (x == 3)
+      return 1;
+    return 2;
+  }
+  if (x > 200)
+    return 3;
+  return 0;
+}
@@ -0,0 +1,30 @@
+// RUN: %llvmgcc %s -emit-llvm -O0 -c -o %t1.bc
+// RUN: rm -rf %t.klee-out
+// RUN: %klee --output-dir=%t.klee-out %t1.bc 2> %t.log
+// RUN: not grep -q "flushing" %t.log
+// RUN: not grep -q "ASSERTION FAIL" %t.log
+
+// A symbolic index which can only reach the start of a large table
+// should only flush that window of the table.
+
+#include <assert.h>
+
+unsigned table[4096];
+
+int main() {
+  unsigned char x;
+  unsigned i;
+
+  for (i = 0; i < 4096; ++i)
+    table[i] = i * 3;
+
+  klee_make_symbolic(&x, sizeof x);
+
+  table[x] = 7;
+  if (x != 10)
+    assert(table[10] == 30);
+  assert(table[x] == 7);
+  assert(table[300] == 900);
+
+  return 0;
+}
@@ -0,0 +1,23 @@
+// RUN: %llvmgcc -emit-llvm -c -g %s -o %t.bc
+// RUN: rm -rf %t.klee-out %t.klee-out-2
+// RUN: %klee --output-dir=%t.klee-out --write-test-pack %t.bc
+// RUN: not ls %t.klee-out/test000001.ktest
+// RUN: ktest-tool %t.klee-out/tests.ktestpack | grep -c "^ktest file" | grep -qx 4
+
+// The tests of a pack can be used as seeds like .ktest files.
+// RUN: %klee --output-dir=%t.klee-out-2 --only-seed --only-replay-seeds --seed-out=%t.klee-out/tests.ktestpack %t.bc
+// RUN: ls %t.klee-out-2 | grep -c "\.ktest$" | grep -qx 4
+
+int main() {
+  unsigned char x;
+  klee_make_symbolic(&x, sizeof x, "x");
+
+  if (x < 10) {
+    if (x == 3)
+      return 1;
+    return 2;
+  }
+  if (x > 200)
+    return 3;
+  return 0;
+}
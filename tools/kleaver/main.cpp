@@ -14,14 +14,21 @@
 #include "klee/util/ExprVisitor.h"
 
 #include "klee/util/ExprSMTLIBPrinter.h"
+#include "klee/Internal/Support/QueryLog.h"
+#include "klee/Internal/System/Time.h"
 
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <sys/stat.h>
+#include <sys/wait.h>
 #include <unistd.h>
 
 // FIXME: Ugh, this is gross. But otherwise our config.h conflicts with LLVMs.
@@ -117,6 +124,26 @@ namespace {
   llvm::cl::opt<std::string> directoryToWriteQueryLogs("query-log-dir",llvm::cl::desc("The folder to write query logs to. Defaults is current working directory."),
 		                                               llvm::cl::init("."));
 
+  llvm::cl::opt<unsigned>
+  Jobs("jobs",
+       llvm::cl::desc("Evaluate queries in the given number of worker processes (default=1)"),
+       llvm::cl::init(1));
+
+  llvm::cl::opt<std::string>
+  QueryReport("query-report",
+              llvm::cl::desc("Write the result and evaluation time of each query to the given file, as CSV"),
+              llvm::cl::value_desc("file"));
+
+  llvm::cl::opt<bool>
+  StreamQueries("stream",
+                llvm::cl::desc("Evaluate each query as soon as it is parsed and free it afterwards, instead of parsing the whole input first"),
+                llvm::cl::init(false));
+
+  llvm::cl::opt<bool>
+  PrintSolverStats("print-solver-stats",
+                   llvm::cl::desc("Print the value of every solver statistic after evaluation"),
+                   llvm::cl::init(false));
+
 }
 
 static std::string getQueryLogPath(const char filename[])
@@ -178,10 +205,54 @@ static void PrintInputTokens(const MemoryBuffer *MB) {
   } while (T.kind != Token::EndOfFile);
 }
 
+/// Read the queries in a binary query log (see --use-query-log) as
+/// query commands.
+static bool ReadQueryLog(const char *Filename,
+                         const MemoryBuffer *MB,
+                         ExprBuilder *Builder,
+                         std::vector<Decl*> &Decls) {
+  QueryLogReader Reader(MB->getBufferStart(), MB->getBufferSize(), Builder);
+  QueryLogEntry Entry;
+  QueryLogResult Result;
+  while (Reader.next(Entry, Result)) {
+    std::vector<ExprHandle> Values;
+    std::vector<const Array*> Objects;
+    ExprHandle Query = Entry.query;
+    if (Entry.type == QueryLogEntry::Value) {
+      Values.push_back(Entry.query);
+      Query = Builder->Constant(0, Expr::Bool);
+    } else if (Entry.type == QueryLogEntry::Cex) {
+      Objects = Entry.objects;
+    }
+    Decls.push_back(new QueryCommand(Entry.exprs, Query, Values, Objects));
+  }
+
+  if (!Reader.getError().empty()) {
+    llvm::errs() << Filename << ": error: " << Reader.getError() << "\n";
+    for (std::vector<Decl*>::iterator it = Decls.begin(),
+           ie = Decls.end(); it != ie; ++it)
+      delete *it;
+    Decls.clear();
+    return false;
+  }
+  return true;
+}
+
 static bool PrintInputAST(const char *Filename,
                           const MemoryBuffer *MB,
                           ExprBuilder *Builder) {
   std::vector<Decl*> Decls;
+  if (QueryLogReader::isQueryLog(MB->getBufferStart(), MB->getBufferSize())) {
+    if (!ReadQueryLog(Filename, MB, Builder, Decls))
+      return false;
+    for (unsigned i = 0, e = Decls.size(); i != e; ++i) {
+      llvm::outs() << "# Query " << i + 1 << "\n";
+      Decls[i]->dump();
+      delete Decls[i];
+    }
+    return true;
+  }
+
   Parser *P = Parser::Create(Filename, MB, Builder);
   P->SetMaxErrors(20);
 
@@ -193,7 +264,12 @@ static bool PrintInputAST(const char *Filename,
 
       D->dump();
     }
-    Decls.push_back(D);
+    // Queries are not needed once printed; arrays are needed by the
+    // parser until the end.
+    if (isa<QueryCommand>(D))
+      delete D;
+    else
+      Decls.push_back(D);
   }
 
   bool success = true;
@@ -211,25 +287,7 @@ static bool PrintInputAST(const char *Filename,
   return success;
 }
 
-static bool EvaluateInputAST(const char *Filename,
-                             const MemoryBuffer *MB,
-                             ExprBuilder *Builder) {
-  std::vector<Decl*> Decls;
-  Parser *P = Parser::Create(Filename, MB, Builder);
-  P->SetMaxErrors(20);
-  while (Decl *D = P->ParseTopLevelDecl()) {
-    Decls.push_back(D);
-  }
-
-  bool success = true;
-  if (unsigned N = P->GetNumErrors()) {
-    llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
-    success = false;
-  }  
-
-  if (!success)
-    return false;
-
+static Solver *createSolver(const std::string &logSuffix) {
   // FIXME: Support choice of solver.
   Solver *coreSolver = NULL; // 
   
@@ -271,84 +329,338 @@ static bool EvaluateInputAST(const char *Filename,
     }
   }
 
-  Solver *S = constructSolverChain(coreSolver,
-                                   getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME),
-                                   getQueryLogPath(ALL_QUERIES_PC_FILE_NAME),
-                                   getQueryLogPath(SOLVER_QUERIES_PC_FILE_NAME));
+  return constructSolverChain(coreSolver,
+                              getQueryLogPath(ALL_QUERIES_SMT2_FILE_NAME) + logSuffix,
+                              getQueryLogPath(SOLVER_QUERIES_SMT2_FILE_NAME) + logSuffix,
+                              getQueryLogPath(ALL_QUERIES_PC_FILE_NAME) + logSuffix,
+                              getQueryLogPath(SOLVER_QUERIES_PC_FILE_NAME) + logSuffix,
+                              getQueryLogPath(ALL_QUERIES_BINARY_FILE_NAME) + logSuffix,
+                              getQueryLogPath(SOLVER_QUERIES_BINARY_FILE_NAME) + logSuffix);
+}
 
-  unsigned Index = 0;
-  for (std::vector<Decl*>::iterator it = Decls.begin(),
-         ie = Decls.end(); it != ie; ++it) {
-    Decl *D = *it;
-    if (QueryCommand *QC = dyn_cast<QueryCommand>(D)) {
-      llvm::outs() << "Query " << Index << ":\t";
-
-      assert("FIXME: Support counterexample query commands!");
-      if (QC->Values.empty() && QC->Objects.empty()) {
-        bool result;
-        if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
-                          result)) {
-          llvm::outs() << (result ? "VALID" : "INVALID");
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else if (!QC->Values.empty()) {
-        assert(QC->Objects.empty() && 
-               "FIXME: Support counterexamples for values and objects!");
-        assert(QC->Values.size() == 1 &&
-               "FIXME: Support counterexamples for multiple values!");
-        assert(QC->Query->isFalse() &&
-               "FIXME: Support counterexamples with non-trivial query!");
-        ref<ConstantExpr> result;
-        if (S->getValue(Query(ConstraintManager(QC->Constraints), 
-                              QC->Values[0]),
-                        result)) {
-          llvm::outs() << "INVALID\n";
-          llvm::outs() << "\tExpr 0:\t" << result;
-        } else {
-          llvm::outs() << "FAIL (reason: "
-                    << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
-                    << ")";
-        }
-      } else {
-        std::vector< std::vector<unsigned char> > result;
-        
-        if (S->getInitialValues(Query(ConstraintManager(QC->Constraints), 
-                                      QC->Query),
-                                QC->Objects, result)) {
-          llvm::outs() << "INVALID\n";
-
-          for (unsigned i = 0, e = result.size(); i != e; ++i) {
-            llvm::outs() << "\tArray " << i << ":\t"
-                       << QC->Objects[i]->name
-                       << "[";
-            for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
-              llvm::outs() << (unsigned) result[i][j];
-              if (j + 1 != QC->Objects[i]->size)
-                llvm::outs() << ", ";
-            }
-            llvm::outs() << "]";
-            if (i + 1 != e)
-              llvm::outs() << "\n";
-          }
-        } else {
-          SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
-          if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
-            llvm::outs() << " FAIL (reason: "
-                      << SolverImpl::getOperationStatusString(retCode)
-                      << ")";
-          }           
-          else {
-            llvm::outs() << "VALID (counterexample request ignored)";
-          }
+namespace {
+  enum QueryStatus {
+    QueryValid,
+    QueryInvalid,
+    QueryFailed
+  };
+
+  const char *queryStatusNames[] = { "VALID", "INVALID", "FAIL" };
+
+  struct QueryResult {
+    QueryStatus status;
+    double time;
+    /// The result as printed after the query number.
+    std::string output;
+
+    QueryResult() : status(QueryFailed), time(0) {}
+  };
+}
+
+static void EvaluateQuery(Solver *S, QueryCommand *QC, QueryResult &res) {
+  llvm::raw_string_ostream os(res.output);
+  double start = util::getWallTime();
+
+  assert("FIXME: Support counterexample query commands!");
+  if (QC->Values.empty() && QC->Objects.empty()) {
+    bool result;
+    if (S->mustBeTrue(Query(ConstraintManager(QC->Constraints), QC->Query),
+                      result)) {
+      os << (result ? "VALID" : "INVALID");
+      res.status = result ? QueryValid : QueryInvalid;
+    } else {
+      os << "FAIL (reason: "
+         << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+         << ")";
+    }
+  } else if (!QC->Values.empty()) {
+    assert(QC->Objects.empty() && 
+           "FIXME: Support counterexamples for values and objects!");
+    assert(QC->Values.size() == 1 &&
+           "FIXME: Support counterexamples for multiple values!");
+    assert(QC->Query->isFalse() &&
+           "FIXME: Support counterexamples with non-trivial query!");
+    ref<ConstantExpr> result;
+    if (S->getValue(Query(ConstraintManager(QC->Constraints), 
+                          QC->Values[0]),
+                    result)) {
+      os << "INVALID\n";
+      os << "\tExpr 0:\t" << result;
+      res.status = QueryInvalid;
+    } else {
+      os << "FAIL (reason: "
+         << SolverImpl::getOperationStatusString(S->impl->getOperationStatusCode())
+         << ")";
+    }
+  } else {
+    std::vector< std::vector<unsigned char> > result;
+    
+    if (S->getInitialValues(Query(ConstraintManager(QC->Constraints), 
+                                  QC->Query),
+                            QC->Objects, result)) {
+      os << "INVALID\n";
+      res.status = QueryInvalid;
+
+      for (unsigned i = 0, e = result.size(); i != e; ++i) {
+        os << "\tArray " << i << ":\t"
+           << QC->Objects[i]->name
+           << "[";
+        for (unsigned j = 0; j != QC->Objects[i]->size; ++j) {
+          os << (unsigned) result[i][j];
+          if (j + 1 != QC->Objects[i]->size)
+            os << ", ";
         }
+        os << "]";
+        if (i + 1 != e)
+          os << "\n";
+      }
+    } else {
+      SolverImpl::SolverRunStatus retCode = S->impl->getOperationStatusCode();
+      if (SolverImpl::SOLVER_RUN_STATUS_TIMEOUT == retCode) {
+        os << " FAIL (reason: "
+           << SolverImpl::getOperationStatusString(retCode)
+           << ")";
+      }           
+      else {
+        os << "VALID (counterexample request ignored)";
+        res.status = QueryValid;
+      }
+    }
+  }
+
+  os.flush();
+  res.time = util::getWallTime() - start;
+}
+
+static bool writeAll(FILE *f, const void *data, size_t size) {
+  return fwrite(data, 1, size, f) == size;
+}
+
+static bool readAll(FILE *f, void *data, size_t size) {
+  return fread(data, 1, size, f) == size;
+}
+
+/// Evaluate the queries in forked worker processes, each with its own
+/// solver chain (neither the expression library nor the solvers are
+/// thread safe). Worker k evaluates every Jobs'th query starting at k,
+/// and reports its results and statistics through a temporary file.
+static void EvaluateQueriesInParallel(const std::vector<QueryCommand*> &Queries,
+                                      std::vector<QueryResult> &Results) {
+  StatisticManager &sm = *theStatisticManager;
+  std::vector<FILE*> files;
+  std::vector<pid_t> pids;
+
+  for (unsigned k = 0; k != Jobs; ++k) {
+    FILE *f = tmpfile();
+    if (!f) {
+      llvm::errs() << "error: unable to create worker output file\n";
+      exit(1);
+    }
+    llvm::outs().flush();
+    llvm::errs().flush();
+
+    pid_t pid = fork();
+    if (pid < 0) {
+      llvm::errs() << "error: unable to fork worker\n";
+      exit(1);
+    }
+    if (pid == 0) {
+      Solver *S = createSolver("." + llvm::utostr(k));
+      bool ok = true;
+      for (uint32_t i = k; ok && i < Queries.size(); i += Jobs) {
+        QueryResult res;
+        EvaluateQuery(S, Queries[i], res);
+        uint8_t status = res.status;
+        uint32_t length = res.output.size();
+        ok = writeAll(f, &i, sizeof i) &&
+          writeAll(f, &status, sizeof status) &&
+          writeAll(f, &res.time, sizeof res.time) &&
+          writeAll(f, &length, sizeof length) &&
+          writeAll(f, res.output.data(), length);
+      }
+      delete S;
+
+      // Terminate the results and pass on this worker's statistics.
+      uint32_t end = ~0U;
+      ok = ok && writeAll(f, &end, sizeof end);
+      for (unsigned i = 0; ok && i != sm.getNumStatistics(); ++i) {
+        uint64_t value = sm.getValue(sm.getStatistic(i));
+        ok = writeAll(f, &value, sizeof value);
+      }
+      ok = fflush(f) == 0 && ok;
+      _exit(ok ? 0 : 1);
+    }
+
+    files.push_back(f);
+    pids.push_back(pid);
+  }
+
+  for (unsigned k = 0; k != Jobs; ++k) {
+    int status;
+    while (waitpid(pids[k], &status, 0) < 0 && errno == EINTR)
+      ;
+
+    // Whatever a worker did not report (if it crashed) stays failed.
+    FILE *f = files[k];
+    rewind(f);
+    uint32_t i = 0;
+    while (readAll(f, &i, sizeof i) && i != ~0U) {
+      uint8_t status;
+      uint32_t length;
+      QueryResult res;
+      if (i >= Results.size() ||
+          !readAll(f, &status, sizeof status) ||
+          !readAll(f, &res.time, sizeof res.time) ||
+          !readAll(f, &length, sizeof length))
+        break;
+      res.status = (QueryStatus) status;
+      res.output.resize(length);
+      if (length && !readAll(f, &res.output[0], length))
+        break;
+      Results[i] = res;
+    }
+    if (i == ~0U) {
+      for (unsigned j = 0; j != sm.getNumStatistics(); ++j) {
+        uint64_t value;
+        if (!readAll(f, &value, sizeof value))
+          break;
+        Statistic &s = sm.getStatistic(j);
+        sm.setValue(s, sm.getValue(s) + value);
+      }
+    } else {
+      llvm::errs() << "warning: worker " << k << " did not complete\n";
+    }
+    fclose(f);
+  }
+
+  for (unsigned i = 0, e = Results.size(); i != e; ++i)
+    if (Results[i].output.empty())
+      Results[i].output = "FAIL (reason: worker did not complete)";
+}
+
+/// Parse and evaluate the input one query at a time, freeing each
+/// query once it has been evaluated, so that memory use is bounded by
+/// the largest query rather than by the whole input.
+static bool EvaluateQueryStream(const char *Filename,
+                                const MemoryBuffer *MB,
+                                ExprBuilder *Builder,
+                                std::vector<QueryResult> &Results) {
+  Parser *P = Parser::Create(Filename, MB, Builder);
+  P->SetMaxErrors(20);
+  Solver *S = createSolver("");
+
+  // Array declarations are needed by the parser until the end.
+  std::vector<Decl*> ArrayDecls;
+  while (Decl *D = P->ParseTopLevelDecl()) {
+    QueryCommand *QC = dyn_cast<QueryCommand>(D);
+    if (!QC) {
+      ArrayDecls.push_back(D);
+      continue;
+    }
+
+    // After a parse error, keep parsing to report any further errors
+    // but stop evaluating.
+    if (!P->GetNumErrors()) {
+      Results.push_back(QueryResult());
+      QueryResult &res = Results.back();
+      llvm::outs() << "Query " << Results.size() - 1 << ":\t";
+      EvaluateQuery(S, QC, res);
+      llvm::outs() << res.output << "\n";
+      res.output.clear();
+    }
+    delete QC;
+  }
+
+  bool success = true;
+  if (unsigned N = P->GetNumErrors()) {
+    llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
+    success = false;
+  }
+
+  delete S;
+  for (std::vector<Decl*>::iterator it = ArrayDecls.begin(),
+         ie = ArrayDecls.end(); it != ie; ++it)
+    delete *it;
+  delete P;
+
+  return success;
+}
+
+static bool EvaluateInputAST(const char *Filename,
+                             const MemoryBuffer *MB,
+                             ExprBuilder *Builder) {
+  std::vector<Decl*> Decls;
+  std::vector<QueryResult> Results;
+  Parser *P = 0;
+  bool success = true;
+  bool IsQueryLog =
+    QueryLogReader::isQueryLog(MB->getBufferStart(), MB->getBufferSize());
+  // When streaming, the evaluation time includes parsing.
+  bool Streamed = StreamQueries && !IsQueryLog;
+  double start = util::getWallTime();
+  if (Streamed) {
+    if (!EvaluateQueryStream(Filename, MB, Builder, Results))
+      return false;
+  } else if (IsQueryLog) {
+    if (!ReadQueryLog(Filename, MB, Builder, Decls))
+      return false;
+  } else {
+    P = Parser::Create(Filename, MB, Builder);
+    P->SetMaxErrors(20);
+    while (Decl *D = P->ParseTopLevelDecl()) {
+      Decls.push_back(D);
+    }
+
+    if (unsigned N = P->GetNumErrors()) {
+      llvm::errs() << Filename << ": parse failure: " << N << " errors.\n";
+      success = false;
+    }  
+
+    if (!success)
+      return false;
+  }
+
+  if (!Streamed) {
+    std::vector<QueryCommand*> Queries;
+    for (std::vector<Decl*>::iterator it = Decls.begin(),
+           ie = Decls.end(); it != ie; ++it)
+      if (QueryCommand *QC = dyn_cast<QueryCommand>(*it))
+        Queries.push_back(QC);
+
+    Results.resize(Queries.size());
+    start = util::getWallTime();
+    if (Jobs > 1) {
+      EvaluateQueriesInParallel(Queries, Results);
+      for (unsigned i = 0, e = Results.size(); i != e; ++i)
+        llvm::outs() << "Query " << i << ":\t" << Results[i].output << "\n";
+    } else {
+      Solver *S = createSolver("");
+      for (unsigned i = 0, e = Queries.size(); i != e; ++i) {
+        llvm::outs() << "Query " << i << ":\t";
+        EvaluateQuery(S, Queries[i], Results[i]);
+        llvm::outs() << Results[i].output << "\n";
       }
+      delete S;
+    }
+  }
+  double elapsed = util::getWallTime() - start;
 
-      llvm::outs() << "\n";
-      ++Index;
+  if (!QueryReport.empty()) {
+    std::string Error;
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3, 5)
+    llvm::raw_fd_ostream report(QueryReport.c_str(), Error,
+                                llvm::sys::fs::OpenFlags::F_Text);
+#else
+    llvm::raw_fd_ostream report(QueryReport.c_str(), Error);
+#endif
+    if (!Error.empty()) {
+      llvm::errs() << "error: unable to open query report: " << Error << "\n";
+      success = false;
+    } else {
+      report << "query,result,time\n";
+      for (unsigned i = 0, e = Results.size(); i != e; ++i)
+        report << i << "," << queryStatusNames[Results[i].status] << ","
+               << format("%.6f", Results[i].time) << "\n";
     }
   }
 
@@ -357,8 +669,6 @@ static bool EvaluateInputAST(const char *Filename,
     delete *it;
   delete P;
 
-  delete S;
-
   if (uint64_t queries = *theStatisticManager->getStatisticByName("Queries")) {
     llvm::outs()
       << "--\n"
@@ -372,6 +682,21 @@ static bool EvaluateInputAST(const char *Filename,
       << "query cex = " 
       << *theStatisticManager->getStatisticByName("QueriesCEX") << "\n";
   }
+  if (Jobs > 1 || !QueryReport.empty())
+    llvm::outs()
+      << "jobs = " << std::max(1U, (unsigned) Jobs) << "\n"
+      << "evaluation time = " << format("%.6f", elapsed) << "\n"
+      << "queries per second = "
+      << format("%.1f", elapsed > 0 ? Results.size() / elapsed : 0.) << "\n";
+
+  if (PrintSolverStats) {
+    StatisticManager &sm = *theStatisticManager;
+    llvm::outs() << "--\n";
+    for (unsigned i = 0; i != sm.getNumStatistics(); ++i) {
+      Statistic &s = sm.getStatistic(i);
+      llvm::outs() << "stat " << s.getName() << " = " << sm.getValue(s) << "\n";
+    }
+  }
 
   return success;
 }
@@ -382,23 +707,32 @@ static bool printInputAsSMTLIBv2(const char *Filename,
 {
 	//Parse the input file
 	std::vector<Decl*> Decls;
-	Parser *P = Parser::Create(Filename, MB, Builder);
-	P->SetMaxErrors(20);
-	while (Decl *D = P->ParseTopLevelDecl())
+	Parser *P = 0;
+	if (QueryLogReader::isQueryLog(MB->getBufferStart(), MB->getBufferSize()))
 	{
-		Decls.push_back(D);
+		if (!ReadQueryLog(Filename, MB, Builder, Decls))
+			return false;
 	}
-
-	bool success = true;
-	if (unsigned N = P->GetNumErrors())
+	else
 	{
-		llvm::errs() << Filename << ": parse failure: "
-				   << N << " errors.\n";
-		success = false;
-	}
+		P = Parser::Create(Filename, MB, Builder);
+		P->SetMaxErrors(20);
+		while (Decl *D = P->ParseTopLevelDecl())
+		{
+			Decls.push_back(D);
+		}
+
+		bool success = true;
+		if (unsigned N = P->GetNumErrors())
+		{
+			llvm::errs() << Filename << ": parse failure: "
+					   << N << " errors.\n";
+			success = false;
+		}
 
-	if (!success)
-	return false;
+		if (!success)
+		return false;
+	}
 
 	ExprSMTLIBPrinter printer;
 	printer.setOutput(llvm::outs());
@@ -453,6 +787,11 @@ int main(int argc, char **argv) {
   llvm::sys::PrintStackTraceOnErrorSignal();
   llvm::cl::ParseCommandLineOptions(argc, argv);
 
+  if (StreamQueries && Jobs > 1) {
+    llvm::errs() << argv[0] << ": error: --stream cannot be used with --jobs\n";
+    return 1;
+  }
+
   std::string ErrorStr;
   
 #if LLVM_VERSION_CODE < LLVM_VERSION(3,5)
@@ -13,6 +13,7 @@
 #include "klee/Config/config.h"
 
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -244,8 +245,59 @@ void ensure_capsyschroot(const char *executable) {
 }
 #endif
 
+/* Replay the current input, named name, in a subprocess. */
+static void replay_input(char *executable, char *argv0, const char *name,
+                         int separate) {
+  int prg_argc;
+  char ** prg_argv;
+  unsigned i;
+
+  obj_index = 0;
+  prg_argc = input->numArgs;
+  prg_argv = input->args;
+  prg_argv[0] = argv0;
+  klee_init_env(&prg_argc, &prg_argv);
+
+  if (separate)
+    fprintf(stderr, "\n");
+  fprintf(stderr, "%s: TEST CASE: %s\n", progname, name);
+  fprintf(stderr, "%s: ARGS: ", progname);
+  for (i=0; i != (unsigned) prg_argc; ++i) {
+    char *s = prg_argv[i];
+    if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
+    fprintf(stderr, "\"%s\" ", prg_argv[i]); 
+  }
+  fprintf(stderr, "\n");
+
+  /* Run the test case machinery in a subprocess, eventually this parent
+     process should be a script or something which shells out to the actual
+     execution tool. */
+  int pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    _exit(66);
+  } else if (pid == 0) {
+    /* Create the input files, pipes, etc., and run the process. */
+    replay_create_files(&__exe_fs);
+    run_monitored(executable, prg_argc, prg_argv);
+    _exit(0);
+  } else {
+    /* Wait for the test case. */
+    int res, status;
+
+    do {
+      res = waitpid(pid, &status, 0);
+    } while (res < 0 && errno == EINTR);
+    
+    if (res < 0) {
+      perror("waitpid");
+      _exit(66);
+    }
+  }
+}
+
 static void usage(void) {
-  fprintf(stderr, "Usage: %s [option]... <executable> <ktest-file>...\n", progname);
+  fprintf(stderr, "Usage: %s [option]... <executable> <ktest-file or pack>...\n", progname);
   fprintf(stderr, "   or: %s --create-files-only <ktest-file>\n", progname);
   fprintf(stderr, "\n");
   fprintf(stderr, "-r, --chroot-to-dir=DIR  use chroot jail, requires CAP_SYS_CHROOT\n");
@@ -324,57 +376,38 @@ int main(int argc, char** argv) {
   int idx = 0;
   for (idx = optind + 1; idx != argc; ++idx) {
     char* input_fname = argv[idx];
-    unsigned i;
-    
+
+    if (kTest_isKTestPack(input_fname)) {
+      KTestPack *pack = kTestPack_open(input_fname);
+      unsigned i, n;
+      if (!pack) {
+        fprintf(stderr, "%s: error: input file %s not valid.\n", progname,
+                input_fname);
+        exit(1);
+      }
+      for (i = 0, n = kTestPack_numTests(pack); i != n; ++i) {
+        char name[PATH_MAX + 16];
+        input = kTestPack_getTest(pack, i);
+        if (!input) {
+          fprintf(stderr, "%s: error: test %u of %s not valid.\n", progname,
+                  i, input_fname);
+          exit(1);
+        }
+        snprintf(name, sizeof(name), "%s:%u", input_fname, i);
+        replay_input(executable, argv[optind], name, idx > 2 || i);
+        kTest_free(input);
+      }
+      kTestPack_close(pack);
+      continue;
+    }
+
     input = kTest_fromFile(input_fname);
     if (!input) {
       fprintf(stderr, "%s: error: input file %s not valid.\n", progname, 
               input_fname);
       exit(1);
     }
-    
-    obj_index = 0;
-    prg_argc = input->numArgs;
-    prg_argv = input->args;
-    prg_argv[0] = argv[optind];
-    klee_init_env(&prg_argc, &prg_argv);
-
-    if (idx > 2)
-      fprintf(stderr, "\n");
-    fprintf(stderr, "%s: TEST CASE: %s\n", progname, input_fname);
-    fprintf(stderr, "%s: ARGS: ", progname);
-    for (i=0; i != (unsigned) prg_argc; ++i) {
-      char *s = prg_argv[i];
-      if (s[0]=='A' && s[1] && !s[2]) s[1] = '\0';
-      fprintf(stderr, "\"%s\" ", prg_argv[i]); 
-    }
-    fprintf(stderr, "\n");
-
-    /* Run the test case machinery in a subprocess, eventually this parent
-       process should be a script or something which shells out to the actual
-       execution tool. */
-    int pid = fork();
-    if (pid < 0) {
-      perror("fork");
-      _exit(66);
-    } else if (pid == 0) {
-      /* Create the input files, pipes, etc., and run the process. */
-      replay_create_files(&__exe_fs);
-      run_monitored(executable, prg_argc, prg_argv);
-      _exit(0);
-    } else {
-      /* Wait for the test case. */
-      int res, status;
-
-      do {
-        res = waitpid(pid, &status, 0);
-      } while (res < 0 && errno == EINTR);
-      
-      if (res < 0) {
-        perror("waitpid");
-        _exit(66);
-      }
-    }
+    replay_input(executable, argv[optind], input_fname, idx > 2);
   }
 
   return 0;
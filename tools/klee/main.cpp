@@ -40,6 +40,7 @@
 #include "llvm/Support/FileSystem.h"
 #endif
 #include "llvm/Support/FileSystem.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Bitcode/ReaderWriter.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ManagedStatic.h"
@@ -63,7 +64,9 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#include <algorithm>
 #include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iterator>
@@ -122,6 +125,11 @@ namespace {
   cl::opt<bool>
   WriteSymPaths("write-sym-paths", 
                 cl::desc("Write .sym.path files for each test case"));
+
+  cl::opt<bool>
+  WriteTestPack("write-test-pack",
+                cl::desc("Write the inputs of all test cases to a single tests.ktestpack file "
+                         "instead of a .ktest file each (see ktest-tool)"));
     
   cl::opt<bool>
   ExitOnError("exit-on-error", 
@@ -192,6 +200,29 @@ namespace {
   
   cl::list<std::string>
   SeedOutDir("seed-out-dir");
+
+  cl::opt<std::string>
+  ResumeFrom("resume-from",
+             cl::desc("Continue the run checkpointed in the given directory (see --checkpoint-interval)"),
+             cl::value_desc("checkpoint directory"));
+
+  cl::opt<std::string>
+  SyncDir("sync-dir",
+          cl::desc("Exchange inputs with fuzzers sharing the given AFL-style sync directory: "
+                   "tests covering new code are written to its <sync-name>/queue as raw inputs, "
+                   "and the queues of the other instances are run as seeds (see --sync-interval)"),
+          cl::value_desc("directory"));
+
+  cl::opt<std::string>
+  SyncName("sync-name",
+           cl::desc("The name of this instance in the --sync-dir directory (default=klee)"),
+           cl::init("klee"));
+
+  cl::opt<std::string>
+  ModuleCacheDir("module-cache-dir",
+                 cl::desc("Reuse modules prepared by earlier runs on the same program "
+                          "and runtime, saving new ones to the given directory"),
+                 cl::value_desc("directory"));
   
   cl::opt<unsigned>
   MakeConcreteSymbolic("make-concrete-symbolic",
@@ -220,10 +251,13 @@ private:
   Interpreter *m_interpreter;
   TreeStreamWriter *m_pathWriter, *m_symPathWriter;
   llvm::raw_ostream *m_infoFile;
+  KTestPackWriter *m_testPack;
 
   SmallString<128> m_outputDirectory;
+  SmallString<128> m_syncDirectory;
 
   unsigned m_testIndex;  // number of tests written so far
+  unsigned m_syncIndex;  // id of the next input exported
   unsigned m_pathsExplored; // number of paths explored so far
 
   // used for writing .ktest files
@@ -245,6 +279,12 @@ public:
                        const char *errorMessage, 
                        const char *errorSuffix);
 
+  /// Write the concatenated values of a test to the queue of this
+  /// instance in the sync directory.
+  void exportTestCase(const std::vector< std::pair<std::string,
+                        std::vector<unsigned char> > > &out);
+  std::string getSyncDirectory() const { return m_syncDirectory.str(); }
+
   std::string getOutputFilename(const std::string &filename);
   llvm::raw_fd_ostream *openOutputFile(const std::string &filename);
   std::string getTestFilename(const std::string &suffix, unsigned id);
@@ -261,6 +301,10 @@ public:
   static void getOutFiles(std::string path,
 			  std::vector<std::string> &results);
 
+  // load the tests of a .ktest file or a pack of them, mapping the files
+  static bool loadTests(const std::string &path,
+                        std::vector<KTest *> &tests);
+
   static std::string getRunTimeLibraryPath(const char *argv0);
 };
 
@@ -269,8 +313,10 @@ KleeHandler::KleeHandler(int argc, char **argv)
     m_pathWriter(0),
     m_symPathWriter(0),
     m_infoFile(0),
+    m_testPack(0),
     m_outputDirectory(),
     m_testIndex(0),
+    m_syncIndex(0),
     m_pathsExplored(0),
     m_argc(argc),
     m_argv(argv) {
@@ -341,11 +387,49 @@ KleeHandler::KleeHandler(int argc, char **argv)
 
   // open info
   m_infoFile = openOutputFile("info");
+
+  if (WriteTestPack) {
+    file_path = getOutputFilename("tests.ktestpack");
+    if (!(m_testPack = kTestPack_create(file_path.c_str())))
+      klee_error("cannot open file \"%s\": %s", file_path.c_str(), strerror(errno));
+  }
+
+  if (SyncDir != "") {
+    m_syncDirectory = SyncDir;
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+    if ((ec = sys::fs::make_absolute(m_syncDirectory)) != errc::success)
+#else
+    if (auto ec = sys::fs::make_absolute(m_syncDirectory))
+#endif
+      klee_error("unable to determine absolute path: %s", ec.message().c_str());
+
+    SmallString<128> instance(m_syncDirectory);
+    sys::path::append(instance, SyncName);
+    SmallString<128> queue(instance);
+    sys::path::append(queue, "queue");
+    const char *dirs[] = { m_syncDirectory.c_str(), instance.c_str(),
+                           queue.c_str() };
+    for (unsigned i = 0; i != 3; ++i)
+      if (mkdir(dirs[i], 0775) < 0 && errno != EEXIST)
+        klee_error("cannot create \"%s\": %s", dirs[i], strerror(errno));
+
+    // Number the exported inputs after those of earlier runs.
+    if (DIR *dir = opendir(queue.c_str())) {
+      while (struct dirent *entry = readdir(dir)) {
+        unsigned id;
+        if (sscanf(entry->d_name, "id:%u", &id) == 1 && id >= m_syncIndex)
+          m_syncIndex = id + 1;
+      }
+      closedir(dir);
+    }
+  }
 }
 
 KleeHandler::~KleeHandler() {
   if (m_pathWriter) delete m_pathWriter;
   if (m_symPathWriter) delete m_symPathWriter;
+  if (m_testPack && !kTestPack_finish(m_testPack))
+    klee_warning("unable to finish tests.ktestpack, its index is lost");
   fclose(klee_warning_file);
   fclose(klee_message_file);
   delete m_infoFile;
@@ -367,6 +451,39 @@ void KleeHandler::setInterpreter(Interpreter *i) {
   }
 }
 
+void KleeHandler::exportTestCase(const std::vector< std::pair<std::string,
+                                   std::vector<unsigned char> > > &out) {
+  // Write under a temporary name and link it into the queue, so that
+  // fuzzers scanning the queue never see a partial input. Unlike rename,
+  // link never replaces an entry: names already taken are skipped.
+  SmallString<128> tmp(m_syncDirectory), path;
+  sys::path::append(tmp, SyncName, ".export");
+
+  FILE *f = fopen(tmp.c_str(), "wb");
+  bool ok = f != NULL;
+  for (unsigned i = 0; ok && i != out.size(); ++i)
+    if (!out[i].second.empty())
+      ok = fwrite(&out[i].second[0], 1, out[i].second.size(), f) ==
+           out[i].second.size();
+  if (f && fclose(f) != 0)
+    ok = false;
+
+  while (ok) {
+    std::stringstream name;
+    name << "id:" << std::setfill('0') << std::setw(6) << m_syncIndex++
+         << ",src:klee";
+    path = m_syncDirectory;
+    sys::path::append(path, SyncName, "queue", name.str());
+    if (link(tmp.c_str(), path.c_str()) == 0)
+      break;
+    ok = errno == EEXIST;
+  }
+  if (!ok)
+    klee_warning("unable to export test case to \"%s\": %s",
+                 path.empty() ? tmp.c_str() : path.c_str(), strerror(errno));
+  unlink(tmp.c_str());
+}
+
 std::string KleeHandler::getOutputFilename(const std::string &filename) {
   SmallString<128> path = m_outputDirectory;
   sys::path::append(path,filename);
@@ -446,13 +563,18 @@ void KleeHandler::processTestCase(const ExecutionState &state,
         std::copy(out[i].second.begin(), out[i].second.end(), o->bytes);
       }
       
-      if (!kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
+      if (m_testPack ? !kTestPack_add(m_testPack, &b) :
+          !kTest_toFile(&b, getOutputFilename(getTestFilename("ktest", id)).c_str())) {
         klee_warning("unable to write output test case, losing it");
       }
       
       for (unsigned i=0; i<b.numObjects; i++)
         delete[] b.objects[i].bytes;
       delete[] b.objects;
+
+      // Only tests covering new code are worth a fuzzer's time.
+      if (!m_syncDirectory.empty() && state.coveredNew)
+        exportTestCase(out);
     }
 
     if (errorMessage) {
@@ -553,6 +675,29 @@ void KleeHandler::loadPathFile(std::string name,
   }
 }
 
+bool KleeHandler::loadTests(const std::string &path,
+                            std::vector<KTest *> &tests) {
+  if (!kTest_isKTestPack(path.c_str())) {
+    KTest *test = kTest_mapFile(path.c_str());
+    if (test)
+      tests.push_back(test);
+    return test != 0;
+  }
+
+  KTestPack *pack = kTestPack_open(path.c_str());
+  if (!pack)
+    return false;
+  bool ok = true;
+  for (unsigned i = 0, e = kTestPack_numTests(pack); ok && i != e; ++i) {
+    KTest *test = kTestPack_getTest(pack, i);
+    if (test)
+      tests.push_back(test);
+    ok = test != 0;
+  }
+  kTestPack_close(pack);
+  return ok;
+}
+
 void KleeHandler::getOutFiles(std::string path,
 			      std::vector<std::string> &results) {
 #if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
@@ -562,7 +707,7 @@ void KleeHandler::getOutFiles(std::string path,
 #endif
   for (llvm::sys::fs::directory_iterator i(path,ec),e; i!=e && !ec; i.increment(ec)){
     std::string f = (*i).path();
-    if (f.substr(f.size()-6,f.size()) == ".ktest") {
+    if (StringRef(f).endswith(".ktest") || StringRef(f).endswith(".ktestpack")) {
           results.push_back(f);
     }
   }
@@ -1139,6 +1284,175 @@ static llvm::Module *linkWithUclibc(llvm::Module *mainModule, StringRef libDir)
 }
 #endif
 
+/// Load and fully materialize the bitcode module in the given file (or
+/// stdin for "-"), returning null and setting ErrorMsg on failure.
+static Module *loadBitcode(const std::string &path, std::string &ErrorMsg) {
+  Module *module = 0;
+#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
+  OwningPtr<MemoryBuffer> BufferPtr;
+  error_code ec=MemoryBuffer::getFileOrSTDIN(path.c_str(), BufferPtr);
+  if (ec) {
+    ErrorMsg = ec.message();
+    return 0;
+  }
+
+  module = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
+
+  if (module) {
+    if (module->MaterializeAllPermanently(&ErrorMsg)) {
+      delete module;
+      module = 0;
+    }
+  }
+#else
+  auto Buffer = MemoryBuffer::getFileOrSTDIN(path.c_str());
+  if (!Buffer) {
+    ErrorMsg = Buffer.getError().message();
+    return 0;
+  }
+
+  auto moduleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
+
+  if (!moduleOrError) {
+    ErrorMsg = moduleOrError.getError().message();
+    return 0;
+  }
+  // The module has taken ownership of the MemoryBuffer so release it
+  // from the std::unique_ptr
+  Buffer->release();
+
+  module = *moduleOrError;
+  if (auto ec = module->materializeAllPermanently()) {
+    ErrorMsg = ec.message();
+    delete module;
+    return 0;
+  }
+#endif
+  return module;
+}
+
+static void hashBytes(uint64_t &hash, const void *data, size_t size) {
+  // FNV-1a
+  const unsigned char *p = (const unsigned char*) data;
+  for (size_t i = 0; i != size; ++i) {
+    hash ^= p[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+static void hashString(uint64_t &hash, const std::string &s) {
+  hashBytes(hash, s.c_str(), s.size() + 1);
+}
+
+/// Options which only affect where a run reads or writes its results,
+/// and so can differ between runs sharing a prepared module.
+static bool isPerRunOption(const char *arg) {
+  static const char *options[] = {
+    "output-dir", "seed-out", "seed-out-dir", "replay-out", "replay-out-dir",
+    "replay-path", "resume-from", "module-cache-dir"
+  };
+  while (*arg == '-')
+    ++arg;
+  std::string name(arg, strcspn(arg, "="));
+  for (unsigned i = 0; i != sizeof(options)/sizeof(options[0]); ++i)
+    if (name == options[i])
+      return true;
+  return false;
+}
+
+/// Hash the name, size and modification time of a regular file.
+static void hashFileStamp(uint64_t &hash, const std::string &path,
+                          const std::string &name) {
+  struct stat st;
+  if (stat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode))
+    return;
+  hashString(hash, name);
+  uint64_t attrs[2] = { (uint64_t) st.st_size, (uint64_t) st.st_mtime };
+  hashBytes(hash, attrs, sizeof attrs);
+}
+
+/// Compute the name under which the prepared module for this run is
+/// cached: a hash of the KLEE executable, the program, the runtime
+/// libraries it may be linked with, and the KLEE options given before
+/// the program. Any option is assumed to possibly affect preparation,
+/// so at worst an irrelevant one causes a needless miss.
+static std::string getModuleCacheKey(int argc, char **argv,
+                                     const std::string &libraryDir) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  // Another build of KLEE may prepare modules differently.
+  void *MainExecAddr = (void *)(intptr_t)getModuleCacheKey;
+  std::string executable =
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,4)
+    llvm::sys::fs::getMainExecutable(argv[0], MainExecAddr);
+#else
+    llvm::sys::Path::GetMainExecutable(argv[0], MainExecAddr).str();
+#endif
+  hashFileStamp(hash, executable, executable);
+
+  std::ifstream in(InputFile.c_str(), std::ios::binary);
+  char buf[4096];
+  while (in.read(buf, sizeof buf) || in.gcount())
+    hashBytes(hash, buf, in.gcount());
+
+  if (DIR *dir = opendir(libraryDir.c_str())) {
+    std::vector<std::string> names;
+    while (struct dirent *de = readdir(dir))
+      names.push_back(de->d_name);
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (unsigned i = 0; i != names.size(); ++i)
+      hashFileStamp(hash, libraryDir + "/" + names[i], names[i]);
+  }
+
+  for (int i = 1; i < argc && argv[i] != InputFile; ++i) {
+    if (isPerRunOption(argv[i])) {
+      // Skip the value as well when it is given separately.
+      if (!strchr(argv[i], '=') && i + 1 < argc)
+        ++i;
+      continue;
+    }
+    hashString(hash, argv[i]);
+  }
+
+  char key[17];
+  sprintf(key, "%016llx", (unsigned long long) hash);
+  return key;
+}
+
+/// Save a prepared module under the given cache path. The module is
+/// written to a temporary file first so that concurrent runs never see
+/// a partial module.
+static void saveModuleCache(const Module *module, const std::string &path) {
+  std::string tmpPath = path + "." + llvm::utostr(getpid()) + ".tmp";
+  std::string Error;
+  {
+#if LLVM_VERSION_CODE >= LLVM_VERSION(3,5)
+    llvm::raw_fd_ostream f(tmpPath.c_str(), Error, llvm::sys::fs::F_None);
+#elif LLVM_VERSION_CODE >= LLVM_VERSION(3,4)
+    llvm::raw_fd_ostream f(tmpPath.c_str(), Error, llvm::sys::fs::F_Binary);
+#else
+    llvm::raw_fd_ostream f(tmpPath.c_str(), Error,
+                           llvm::raw_fd_ostream::F_Binary);
+#endif
+    if (Error.empty()) {
+      WriteBitcodeToFile(module, f);
+      f.close();
+      if (f.has_error()) {
+        Error = "write failed";
+        f.clear_error();
+      }
+    }
+  }
+  if (Error.empty() && rename(tmpPath.c_str(), path.c_str()) < 0)
+    Error = strerror(errno);
+  if (!Error.empty()) {
+    klee_warning("unable to save prepared module '%s': %s",
+                 path.c_str(), Error.c_str());
+    unlink(tmpPath.c_str());
+  }
+}
+
 int main(int argc, char **argv, char **envp) {  
 #if ENABLE_STPLOG == 1
   STPLOG_init("stplog.c");
@@ -1217,66 +1531,47 @@ int main(int argc, char **argv, char **envp) {
   sys::SetInterruptFunction(interrupt_handle);
 
   // Load the bytecode...
+  std::string LibraryDir = KleeHandler::getRunTimeLibraryPath(argv[0]);
   std::string ErrorMsg;
   Module *mainModule = 0;
-#if LLVM_VERSION_CODE < LLVM_VERSION(3, 5)
-  OwningPtr<MemoryBuffer> BufferPtr;
-  error_code ec=MemoryBuffer::getFileOrSTDIN(InputFile.c_str(), BufferPtr);
-  if (ec) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
-
-  mainModule = getLazyBitcodeModule(BufferPtr.get(), getGlobalContext(), &ErrorMsg);
-
-  if (mainModule) {
-    if (mainModule->MaterializeAllPermanently(&ErrorMsg)) {
-      delete mainModule;
-      mainModule = 0;
+  std::string cachePath;
+  if (!ModuleCacheDir.empty() && InputFile != "-") {
+    SmallString<128> path(ModuleCacheDir);
+    sys::path::append(path, getModuleCacheKey(argc, argv, LibraryDir) + ".bc");
+    cachePath = path.str();
+    if (mkdir(ModuleCacheDir.c_str(), 0775) < 0 && errno != EEXIST)
+      klee_error("unable to create module cache directory %s: %s",
+                 ModuleCacheDir.c_str(), strerror(errno));
+    if (access(cachePath.c_str(), R_OK) == 0) {
+      mainModule = loadBitcode(cachePath, ErrorMsg);
+      if (mainModule)
+        klee_message("NOTE: Using prepared module: %s", cachePath.c_str());
+      else
+        klee_warning("unable to load prepared module '%s': %s",
+                     cachePath.c_str(), ErrorMsg.c_str());
     }
   }
-  if (!mainModule)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ErrorMsg.c_str());
-#else
-  auto Buffer = MemoryBuffer::getFileOrSTDIN(InputFile.c_str());
-  if (!Buffer)
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               Buffer.getError().message().c_str());
-
-  auto mainModuleOrError = getLazyBitcodeModule(Buffer->get(), getGlobalContext());
-
-  if (!mainModuleOrError) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               mainModuleOrError.getError().message().c_str());
-  }
-  else {
-    // The module has taken ownership of the MemoryBuffer so release it
-    // from the std::unique_ptr
-    Buffer->release();
+  bool prepared = mainModule != 0;
+  if (!mainModule) {
+    mainModule = loadBitcode(InputFile, ErrorMsg);
+    if (!mainModule)
+      klee_error("error loading program '%s': %s", InputFile.c_str(),
+                 ErrorMsg.c_str());
   }
 
-  mainModule = *mainModuleOrError;
-  if (auto ec = mainModule->materializeAllPermanently()) {
-    klee_error("error loading program '%s': %s", InputFile.c_str(),
-               ec.message().c_str());
-  }
-#endif
-
-
-  if (WithPOSIXRuntime) {
+  if (WithPOSIXRuntime && !prepared) {
     int r = initEnv(mainModule);
     if (r != 0)
       return r;
   }
 
-  std::string LibraryDir = KleeHandler::getRunTimeLibraryPath(argv[0]);
   Interpreter::ModuleOptions Opts(LibraryDir.c_str(),
                                   /*Optimize=*/OptimizeModule, 
                                   /*CheckDivZero=*/CheckDivZero,
                                   /*CheckOvershift=*/CheckOvershift);
+  Opts.Prepared = prepared;
   
-  switch (Libc) {
+  switch (prepared ? NoLibc : Libc) {
   case NoLibc: /* silence compiler warning */
     break;
 
@@ -1298,7 +1593,7 @@ int main(int argc, char **argv, char **envp) {
     break;
   }
 
-  if (WithPOSIXRuntime) {
+  if (WithPOSIXRuntime && !prepared) {
     SmallString<128> Path(Opts.LibraryDir);
     llvm::sys::path::append(Path, "libkleeRuntimePOSIX.bca");
     klee_message("NOTE: Using model: %s", Path.c_str());
@@ -1376,6 +1671,9 @@ int main(int argc, char **argv, char **envp) {
     interpreter->setModule(mainModule, Opts);
   externalsAndGlobalsCheck(finalModule);
 
+  if (!cachePath.empty() && !prepared)
+    saveModuleCache(finalModule, cachePath);
+
   if (ReplayPathFile != "") {
     interpreter->setReplayPath(&replayPath);
   }
@@ -1400,12 +1698,8 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = outFiles.begin(), ie = outFiles.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (out) {
-        kTests.push_back(out);
-      } else {
+      if (!KleeHandler::loadTests(*it, kTests))
         llvm::errs() << "KLEE: unable to open: " << *it << "\n";
-      }
     }
 
     if (RunInDir != "") {
@@ -1423,7 +1717,7 @@ int main(int argc, char **argv, char **envp) {
       interpreter->setReplayOut(out);
       llvm::errs() << "KLEE: replaying: " << *it << " (" << kTest_numBytes(out)
                    << " bytes)"
-                   << " (" << ++i << "/" << outFiles.size() << ")\n";
+                   << " (" << ++i << "/" << kTests.size() << ")\n";
       // XXX should put envp in .ktest ?
       interpreter->runFunctionAsMain(mainFn, out->numArgs, out->args, pEnvp);
       if (interrupted) break;
@@ -1438,12 +1732,10 @@ int main(int argc, char **argv, char **envp) {
     for (std::vector<std::string>::iterator
            it = SeedOutFile.begin(), ie = SeedOutFile.end();
          it != ie; ++it) {
-      KTest *out = kTest_fromFile(it->c_str());
-      if (!out) {
+      if (!KleeHandler::loadTests(*it, seeds)) {
         llvm::errs() << "KLEE: unable to open: " << *it << "\n";
         exit(1);
       }
-      seeds.push_back(out);
     } 
     for (std::vector<std::string>::iterator
            it = SeedOutDir.begin(), ie = SeedOutDir.end();
@@ -1453,12 +1745,10 @@ int main(int argc, char **argv, char **envp) {
       for (std::vector<std::string>::iterator
              it2 = outFiles.begin(), ie = outFiles.end();
            it2 != ie; ++it2) {
-        KTest *out = kTest_fromFile(it2->c_str());
-        if (!out) {
+        if (!KleeHandler::loadTests(*it2, seeds)) {
           llvm::errs() << "KLEE: unable to open: " << *it2 << "\n";
           exit(1);
         }
-        seeds.push_back(out);
       }
       if (outFiles.empty()) {
         llvm::errs() << "KLEE: seeds directory is empty: " << *it << "\n";
@@ -1470,6 +1760,13 @@ int main(int argc, char **argv, char **envp) {
       llvm::errs() << "KLEE: using " << seeds.size() << " seeds\n";
       interpreter->useSeeds(&seeds);
     }
+    if (ResumeFrom != "") {
+      if (!seeds.empty())
+        klee_error("--resume-from cannot be combined with seeds");
+      interpreter->useCheckpoint(ResumeFrom);
+    }
+    if (SyncDir != "")
+      interpreter->useSyncDirectory(handler->getSyncDirectory(), SyncName);
     if (RunInDir != "") {
       int res = chdir(RunInDir.c_str());
       if (res < 0) {
@@ -1513,6 +1810,10 @@ int main(int argc, char **argv, char **envp) {
     *theStatisticManager->getStatisticByName("Instructions");
   uint64_t forks = 
     *theStatisticManager->getStatisticByName("Forks");
+  uint64_t fastPathInstructions =
+    *theStatisticManager->getStatisticByName("FastPathInstructions");
+  uint64_t sharedSeedEvaluations =
+    *theStatisticManager->getStatisticByName("SharedSeedEvaluations");
 
   handler->getInfoStream() 
     << "KLEE: done: explored paths = " << 1 + forks << "\n";
@@ -1528,6 +1829,14 @@ int main(int argc, char **argv, char **envp) {
     << "KLEE: done: valid queries = " << queriesValid << "\n"
     << "KLEE: done: invalid queries = " << queriesInvalid << "\n"
     << "KLEE: done: query cex = " << queryCounterexamples << "\n";
+  if (fastPathInstructions)
+    handler->getInfoStream()
+      << "KLEE: done: fast path instructions = " << fastPathInstructions
+      << "\n";
+  if (sharedSeedEvaluations)
+    handler->getInfoStream()
+      << "KLEE: done: shared seed evaluations = " << sharedSeedEvaluations
+      << "\n";
 
   std::stringstream stats;
   stats << "\n";
@@ -110,4 +110,26 @@ TEST(ExprTest, ExtractConcat) {
   EXPECT_EQ(Expr::Extract, concat2->getKid(1)->getKind());
 }
 
+TEST(ExprTest, ConstantArrayUniquing) {
+  std::vector< ref<ConstantExpr> > values;
+  for (unsigned i = 0; i != 16; ++i)
+    values.push_back(ConstantExpr::create(i, Expr::Int8));
+
+  const ref<ConstantExpr> *begin = &values[0], *end = begin + values.size();
+  const Array *a = Array::CreateUniqueConstantArray("carr0", values.size(),
+                                                    begin, end);
+  const Array *b = Array::CreateUniqueConstantArray("carr1", values.size(),
+                                                    begin, end);
+  EXPECT_EQ(a, b);
+
+  // Arrays created by name keep their identity.
+  const Array *c = Array::CreateArray("carr2", values.size(), begin, end);
+  EXPECT_NE(a, c);
+
+  values[7] = ConstantExpr::create(0, Expr::Int8);
+  const Array *d = Array::CreateUniqueConstantArray("carr3", values.size(),
+                                                    begin, end);
+  EXPECT_NE(a, d);
+}
+
 }